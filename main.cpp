@@ -7,27 +7,66 @@
 #include <chrono>
 #include <algorithm>
 #include <cstring>
+#include <set>
+#include <cerrno>
+#include <cstdlib>
+#include <thread>
+#include <memory>
+#include <csignal>
+#include <ctime>
+#include <poll.h>
+#include <unistd.h>
 #include "module_analization.h"
 #include "module_redactor.h"
+#include "module_snapshot.h"
+#include "module_io_policy.h"
+#include "module_results_view.h"
+#include "module_report.h"
+#include "module_archive.h"
+#include "module_compare.h"
+#include "module_ui_latency.h"
+#include "module_autosave.h"
+#include "module_replace.h"
+#include "module_watch.h"
 
 namespace fs = std::filesystem;
 
 // Глобальные переменные
 std::string current_directory = fs::current_path().string();
-std::vector<std::string> directory_contents; // Содержимое текущей директории
+redactor::DirHandle current_dir_handle; // Дескриптор текущей директории
+std::vector<redactor::DirEntry> directory_contents; // Содержимое текущей директории
+std::set<std::string> marked_items; // Отмеченные элементы для пакетных операций
 size_t selected_index = 0; // Индекс выбранного элемента
+std::string scan_rules_spec; // Правила сканирования в текстовом виде
+ScanMatcher scan_matcher; // Скомпилированные правила сканирования
+std::string io_limits_spec; // Ограничения фонового режима в текстовом виде
+bool latency_overlay = false; // Показ задержек интерфейса поверх списка (F12)
 
-// Обновление списка содержимого директории
+// Перечитывание списка содержимого директории через уже открытый дескриптор.
+// Вызывается при смене директории и после операций, меняющих её содержимое, — не при каждой перерисовке
 void update_directory_contents() {
+    LatencyScope scope(UiLoop::Browser, UiStage::Listing);
     directory_contents.clear();
     if (current_directory != "/") {
-        directory_contents.push_back(".."); // Возврат в родительскую директорию
+        directory_contents.push_back({"..", true}); // Возврат в родительскую директорию
     }
-    for (const auto& entry : fs::directory_iterator(current_directory)) {
-        directory_contents.push_back(entry.path().filename().string());
+    if (!current_dir_handle.is_open()) {
+        current_dir_handle = redactor::DirHandle(current_directory); // Прошлая попытка открыть не удалась
+    }
+    if (current_dir_handle.is_open()) {
+        redactor::list_directory_at(current_dir_handle, directory_contents);
     }
 }
 
+// Смена текущей директории
+void change_directory(const std::string& new_directory) {
+    current_directory = new_directory;
+    current_dir_handle = redactor::DirHandle(current_directory); // Открываем один раз на всё время работы в папке
+    marked_items.clear();
+    update_directory_contents();
+    selected_index = 0;
+}
+
 // Функция ввода строки с поддержкой русских букв и без лишнего пробела
 std::string input_string(WINDOW* win, int y, int x, const std::string& prompt) {
     std::wstring input; // Используем wstring для поддержки широких символов (UTF-8)
@@ -97,6 +136,27 @@ std::string input_string(WINDOW* win, int y, int x, const std::string& prompt) {
     return result;
 }
 
+// Запрос образца и замены. Образец вида /выражение/ — регулярное выражение,
+// /выражение/i — без учёта регистра. false, если ввод отменён пустым образцом.
+bool prompt_replace(WINDOW* win, int y, std::string& pattern, std::string& replacement,
+                    redactor::ReplaceOptions& options) {
+    pattern = input_string(win, y, 1, "Найти (/выражение/ — регулярное): ");
+    if (pattern.empty()) {
+        return false;
+    }
+    options = redactor::ReplaceOptions();
+    if (pattern.size() > 2 && pattern.front() == '/') {
+        std::size_t close = pattern.rfind('/');
+        if (close > 0 && (close == pattern.size() - 1 || pattern.substr(close) == "/i")) {
+            options.regex = true;
+            options.ignore_case = close != pattern.size() - 1;
+            pattern = pattern.substr(1, close - 1);
+        }
+    }
+    replacement = input_string(win, y + 1, 1, "Заменить на: ");
+    return true;
+}
+
 // Функция редактирования файла
 void edit_file_content(WINDOW* main_win, const std::string& file_path) {
     // Устанавливаем локаль для поддержки UTF-8
@@ -104,7 +164,7 @@ void edit_file_content(WINDOW* main_win, const std::string& file_path) {
 
     std::string initial_content = redactor::read_file(file_path);
     std::vector<std::wstring> lines = {L""}; // Храним строки как wstring для поддержки UTF-8
-    bool is_modified = false;
+    std::uint64_t generation = 0; // Номер правки: увеличивается при каждом изменении буфера
 
     // Разбиваем начальное содержимое на строки
     std::wstring wcontent;
@@ -122,28 +182,108 @@ void edit_file_content(WINDOW* main_win, const std::string& file_path) {
     keypad(edit_win, TRUE);
     curs_set(1);
 
+    // Файл восстановления остаётся только после аварийного завершения
+    // или пока файл открыт в другом редакторе
+    SwapInfo swap = inspect_swap_file(file_path, initial_content);
+    if (swap.state == SwapState::InUse) {
+        mvwprintw(edit_win, 1, 1, "Файл %s уже редактируется (процесс %ld).", file_path.c_str(), swap.owner_pid);
+        mvwprintw(edit_win, 2, 1, "Открыть всё равно? (y/n)");
+        wrefresh(edit_win);
+        wint_t answer;
+        wget_wch(edit_win, &answer);
+        if (answer != 'y' && answer != 'Y') {
+            delwin(edit_win);
+            curs_set(0);
+            return;
+        }
+    } else if (swap.state != SwapState::None) {
+        mvwprintw(edit_win, 1, 1, "Найден файл автосохранения для %s.", file_path.c_str());
+        if (swap.state == SwapState::Stale) {
+            mvwprintw(edit_win, 2, 1, "Внимание: файл изменён позже автосохранения, копия может быть устаревшей.");
+        }
+        mvwprintw(edit_win, 3, 1, "Восстановить несохранённые изменения? (y/n)");
+        wrefresh(edit_win);
+        wint_t answer;
+        wget_wch(edit_win, &answer);
+        if (answer == 'y' || answer == 'Y') {
+            lines = std::move(swap.lines);
+            generation = 1; // Восстановленный буфер отличается от файла на диске
+        } else {
+            ::unlink(swap_path_for(file_path).c_str());
+        }
+    }
+
+    // Запись на диск идёт в фоновом потоке из неизменяемых снимков буфера
+    BackgroundSaver saver(file_path);
+    std::uint64_t autosaved_generation = generation;
+    auto last_autosave = std::chrono::steady_clock::now();
+    const auto autosave_interval = std::chrono::seconds(2);
+    auto make_snapshot = [&]() {
+        auto snapshot = std::make_shared<BufferSnapshot>();
+        snapshot->lines = lines;
+        snapshot->generation = generation;
+        return std::shared_ptr<const BufferSnapshot>(std::move(snapshot));
+    };
+    auto is_modified = [&]() { return generation != saver.saved_generation(); };
+    auto mark_modified = [&]() { ++generation; };
+    wtimeout(edit_win, 500); // Периодическое пробуждение для автосохранения и обновления статуса
+
     int y = 0, x = 0; // Текущая позиция курсора в тексте (строка, столбец)
     int scroll_offset = 0; // Смещение для прокрутки
     int max_y = LINES - 5; // Максимальное количество строк на экране
+    std::string status_message; // Результат последней замены, гаснет при следующей клавише
 
     auto redraw = [&]() {
+        LatencyScope render(UiLoop::Editor, UiStage::Render);
         wclear(edit_win);
         box(edit_win, 0, 0);
         mvwprintw(edit_win, 0, 2, "Редактор: %s", file_path.c_str());
-        mvwprintw(edit_win, LINES - 3, 2, "Ctrl+X: Сохранить | Ctrl+C: Выйти | ↑/↓: Прокрутка");
+        mvwprintw(edit_win, LINES - 3, 2, "Ctrl+X: Сохранить | Ctrl+E: Заменить | Ctrl+C: Выйти | ↑/↓: Прокрутка");
+        switch (saver.status()) {
+            case SaveStatus::Saving:
+                wprintw(edit_win, " | Сохранение...");
+                break;
+            case SaveStatus::Failed:
+                wprintw(edit_win, " | Ошибка сохранения: %s", redactor::error_message(saver.last_error()).c_str());
+                break;
+            case SaveStatus::Saved:
+            case SaveStatus::Idle:
+                wprintw(edit_win, "%s", is_modified() ? " | Изменён" : (saver.status() == SaveStatus::Saved ? " | Сохранено" : ""));
+                break;
+        }
+        if (!status_message.empty()) {
+            wprintw(edit_win, " | %s", status_message.c_str());
+        }
 
         // Отображаем видимые строки
         for (int i = scroll_offset; i < static_cast<int>(lines.size()) && i - scroll_offset < max_y; i++) {
             mvwprintw(edit_win, i - scroll_offset + 1, 1, "%ls", lines[i].c_str());
         }
         wmove(edit_win, y - scroll_offset + 1, x + 1); // +1 из-за отступа от рамки
+        LatencyScope refresh(UiLoop::Editor, UiStage::Refresh);
         wrefresh(edit_win);
     };
 
     redraw();
+    SaveStatus drawn_status = saver.status();
 
     wint_t ch;
-    while (wget_wch(edit_win, &ch) != ERR) {
+    while (true) {
+        // Снимок для автосохранения копируется не чаще раза в интервал, запись — в фоне
+        if (generation != autosaved_generation && std::chrono::steady_clock::now() - last_autosave >= autosave_interval) {
+            saver.autosave(make_snapshot());
+            autosaved_generation = generation;
+            last_autosave = std::chrono::steady_clock::now();
+        }
+        if (wget_wch(edit_win, &ch) == ERR) {
+            if (saver.status() != drawn_status) {
+                drawn_status = saver.status();
+                redraw();
+            }
+            continue; // Истёк таймаут ожидания клавиши
+        }
+        latency_key_received(UiLoop::Editor);
+        status_message.clear();
         switch (ch) {
             case KEY_BACKSPACE:
             case 127:
@@ -157,7 +297,7 @@ void edit_file_content(WINDOW* main_win, const std::string& file_path) {
                     y--;
                     if (y < scroll_offset) scroll_offset--;
                 }
-                is_modified = true;
+                mark_modified();
                 break;
             case KEY_DC: // Delete
                 if (x < static_cast<int>(lines[y].length())) {
@@ -166,7 +306,7 @@ void edit_file_content(WINDOW* main_win, const std::string& file_path) {
                     lines[y] += lines[y + 1];
                     lines.erase(lines.begin() + y + 1);
                 }
-                is_modified = true;
+                mark_modified();
                 break;
             case '\n':
                 lines.insert(lines.begin() + y + 1, lines[y].substr(x));
@@ -174,7 +314,7 @@ void edit_file_content(WINDOW* main_win, const std::string& file_path) {
                 y++;
                 x = 0;
                 if (y - scroll_offset >= max_y) scroll_offset++;
-                is_modified = true;
+                mark_modified();
                 break;
             case KEY_UP:
                 if (y > 0) {
@@ -208,100 +348,134 @@ void edit_file_content(WINDOW* main_win, const std::string& file_path) {
                     if (y - scroll_offset >= max_y) scroll_offset++;
                 }
                 break;
-            case 24: // Ctrl+X (Сохранить)
+            case 5: // Ctrl+E (Заменить) — замена идёт тем же потоковым проходом, что и для файлов на диске
                 {
-                    std::string new_content;
-                    for (const auto& line : lines) {
-                        for (wchar_t wc : line) {
-                            if (wc <= 0x7F) new_content += static_cast<char>(wc);
-                            else if (wc <= 0x7FF) {
-                                new_content += static_cast<char>(0xC0 | (wc >> 6));
-                                new_content += static_cast<char>(0x80 | (wc & 0x3F));
-                            } else {
-                                new_content += static_cast<char>(0xE0 | (wc >> 12));
-                                new_content += static_cast<char>(0x80 | ((wc >> 6) & 0x3F));
-                                new_content += static_cast<char>(0x80 | (wc & 0x3F));
-                            }
-                        }
-                        new_content += "\n";
+                    latency_discard_event();
+                    std::string pattern;
+                    std::string replacement;
+                    redactor::ReplaceOptions options;
+                    wtimeout(edit_win, -1); // Ввод без периодического пробуждения
+                    wmove(edit_win, LINES - 5, 1);
+                    wclrtobot(edit_win);
+                    bool confirmed = prompt_replace(edit_win, LINES - 5, pattern, replacement, options);
+                    wtimeout(edit_win, 500);
+                    if (!confirmed) {
+                        break;
                     }
-                    if (redactor::update_file(file_path, new_content)) {
-                        mvwprintw(edit_win, LINES - 2, 2, "Файл сохранен. Нажмите любую клавишу...");
-                        is_modified = false;
+                    std::string output;
+                    std::uint64_t matches = 0;
+                    int error = redactor::replace_in_string(encode_buffer(lines), pattern, replacement, options, output, &matches);
+                    if (error != 0) {
+                        status_message = "Ошибка образца: " + redactor::error_message(error);
                     } else {
-                        mvwprintw(edit_win, LINES - 2, 2, "Ошибка сохранения! Нажмите любую клавишу...");
+                        status_message = "Заменено: " + std::to_string(matches);
+                    }
+                    if (matches > 0) {
+                        lines = decode_buffer(output);
+                        y = std::min<int>(y, lines.size() - 1);
+                        x = std::min<int>(x, lines[y].length());
+                        scroll_offset = std::min(scroll_offset, y);
+                        mark_modified();
                     }
-                    wrefresh(edit_win);
-                    wget_wch(edit_win, &ch); // Ждем нажатия клавиши
-                    redraw();
-                    break;
                 }
+                break;
+            case 24: // Ctrl+X (Сохранить) — запись идёт в фоне, ход сохранения виден в строке состояния
+                saver.save(make_snapshot());
+                autosaved_generation = generation; // Эта правка уже будет в самом файле
+                break;
             case 3: // Ctrl+C (Выйти)
-                if (is_modified) {
-                    mvwprintw(edit_win, LINES - 2, 2, "Несохраненные изменения. Выйти? (y/n)");
+                latency_discard_event();
+                while (saver.status() == SaveStatus::Saving) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10)); // Дожидаемся начатого сохранения
+                }
+                if (is_modified()) {
+                    mvwprintw(edit_win, LINES - 3, 2, "Несохраненные изменения. Выйти? (y/n)");
+                    wclrtoeol(edit_win);
                     wrefresh(edit_win);
                     wint_t confirm;
-                    wget_wch(edit_win, &confirm);
-                    if (confirm == 'y' || confirm == 'Y') {
-                        delwin(edit_win);
-                        curs_set(0);
-                        return; // Возврат в главное меню
+                    while (wget_wch(edit_win, &confirm) == ERR) {
+                    }
+                    if (confirm != 'y' && confirm != 'Y') {
+                        redraw();
+                        break;
                     }
-                    redraw();
-                } else {
-                    delwin(edit_win);
-                    curs_set(0);
-                    return; // Возврат в главное меню
                 }
-                break;
+                saver.discard_swap();
+                delwin(edit_win);
+                curs_set(0);
+                return; // Возврат в главное меню
             default:
                 if (ch >= 32) { // Печатные символы, включая русские
                     lines[y].insert(x, 1, static_cast<wchar_t>(ch));
                     x++;
                     if (x > COLS - 3) x = COLS - 3; // Ограничение по ширине окна
-                    is_modified = true;
+                    mark_modified();
                 }
                 break;
         }
+        latency_update_done();
         redraw();
+        latency_event_done();
     }
-
-    delwin(edit_win);
-    curs_set(0);
 }
 
 // Основной интерфейс с полной перерисовкой
 void show_main_interface(WINDOW* win) {
+    LatencyScope render(UiLoop::Browser, UiStage::Render);
     wclear(win); // Очищаем окно перед отрисовкой
     box(win, 0, 0);
-    update_directory_contents();
     int y = 1;
 
     // Закрепленные подсказки сверху
-    mvwprintw(win, y++, 1, "Ctrl+A: Анализ | Ctrl+N: Новый файл | Ctrl+D: Новая папка | Q: Выход");
-    mvwprintw(win, y++, 1, "↑/↓: Навигация | Enter: Открыть/Перейти | Del: Удалить");
-    mvwprintw(win, y++, 1, "Текущая директория: %s", current_directory.c_str());
+    mvwprintw(win, y++, 1, "Ctrl+A: Анализ | Ctrl+W: Наблюдение | Ctrl+T: Сводка | Ctrl+R: Изменения | Ctrl+P: Упаковать | Ctrl+K: Сравнить | Ctrl+F: Правила | Ctrl+N: Новый файл | Ctrl+D: Новая папка | Q: Выход");
+    mvwprintw(win, y++, 1, "↑/↓: Навигация | Enter: Открыть/Перейти | Space: Отметить | F5: Копировать | F6: Переместить | Del: Удалить | Ctrl+E: Заменить | Ctrl+B: Фоновый режим%s",
+              io_limits_spec.empty() && !current_io_limits().background ? "" : " [вкл]");
+    if (scan_rules_spec.empty()) {
+        mvwprintw(win, y++, 1, "Текущая директория: %s", current_directory.c_str());
+    } else {
+        mvwprintw(win, y++, 1, "Текущая директория: %s | Правила: %s", current_directory.c_str(), scan_rules_spec.c_str());
+    }
     mvwprintw(win, y++, 1, "Содержимое:");
 
     // Отображение списка файлов и папок
     for (size_t i = 0; i < directory_contents.size(); ++i) {
-        std::string item = directory_contents[i];
-        fs::path item_path = current_directory + "/" + item;
+        const auto& item = directory_contents[i];
+        const char* mark = marked_items.count(item.name) ? "*" : " ";
         if (i == selected_index) {
             wattron(win, A_REVERSE); // Выделение выбранного элемента
         }
-        if (item == ".." || fs::is_directory(item_path)) {
-            mvwprintw(win, y++, 1, "[D] %s", item.c_str());
+        if (item.is_directory) {
+            mvwprintw(win, y++, 1, "%s[D] %s", mark, item.name.c_str());
         } else {
-            mvwprintw(win, y++, 1, "[F] %s", item.c_str());
+            mvwprintw(win, y++, 1, "%s[F] %s", mark, item.name.c_str());
         }
         if (i == selected_index) {
             wattroff(win, A_REVERSE);
         }
     }
+
+    // Отладочная сводка задержек в нижней части окна
+    if (latency_overlay) {
+        auto lines = format_latency_report();
+        int top = std::max(y, getmaxy(win) - 1 - static_cast<int>(lines.size()));
+        for (std::size_t i = 0; i < lines.size() && top + static_cast<int>(i) < getmaxy(win) - 1; ++i) {
+            mvwprintw(win, top + i, 1, "%s", lines[i].c_str());
+        }
+    }
+    LatencyScope refresh(UiLoop::Browser, UiStage::Refresh);
     wrefresh(win);
 }
 
+// Клавиши, открывающие диалоги: время ожидания ввода в них не относится к задержке интерфейса
+bool is_modal_key(int ch) {
+    switch (ch) {
+        case 1: case 2: case 4: case 5: case 6: case 11: case 14: case 16: case 18: case 20: case 23:
+        case KEY_F(5): case KEY_F(6): case KEY_DC:
+            return true;
+    }
+    return false;
+}
+
 // Функция анализа
 void analyze_current_directory(WINDOW* win) {
     wclear(win); // Очищаем окно перед анализом
@@ -311,39 +485,820 @@ void analyze_current_directory(WINDOW* win) {
     mvwprintw(win, y++, 1, "Идет анализ...");
     wrefresh(win);
 
-    auto unused_files = find_unused_files_recursive(current_directory, 30);
-    auto duplicate_files = find_duplicate_files_recursive(current_directory);
-    auto empty_dirs = find_empty_directories(current_directory);
+    // Повторный анализ перечитывает только папки, изменившиеся с прошлого снимка
+    // Прерванный анализ продолжается с контрольной точки
+    fs::path snapshot_path = default_snapshot_path(current_directory);
+    fs::path checkpoint_path = default_checkpoint_path(current_directory);
+    ScanSnapshot previous;
+    bool has_previous = load_snapshot(snapshot_path, previous);
+    RescanStats stats;
+    take_scan_errors();
+    ScanSnapshot snapshot = scan_incremental(current_directory, has_previous ? &previous : nullptr, scan_matcher,
+                                             &stats, checkpoint_path);
+
+    AnalysisResults results;
+    results.days_threshold = 30;
+    results.unused_files = find_unused_files_in_snapshot(snapshot, results.days_threshold, scan_matcher);
+    std::vector<FileType> group_types;
+    results.duplicate_groups = find_duplicate_files_in_snapshot(snapshot, scan_matcher, &group_types, checkpoint_path,
+                                                                &results.duplicate_info);
+    results.summary = format_type_stats("Дубликаты по типам (лишние копии):",
+                                        summarize_duplicates_by_type(results.duplicate_groups, group_types,
+                                                                     results.duplicate_info));
+    results.empty_dirs = find_empty_directories_in_snapshot(snapshot);
+    if (save_snapshot(snapshot, snapshot_path)) {
+        std::error_code ec;
+        fs::remove(checkpoint_path, ec);
+    }
+
+    // Пропущенные файлы и папки показываются в сводке, анализ остального не прерывается
+    auto errors = take_scan_errors();
+    if (!errors.empty()) {
+        results.summary.push_back("Пропущено из-за ошибок: " + std::to_string(errors.size()));
+        for (const auto& error : errors) {
+            results.summary.push_back("  " + error.path + ": " + error.reason);
+        }
+    }
+
+    // Выводится только видимая часть результатов, остальное — при прокрутке
+    char title[256];
+    std::snprintf(title, sizeof(title), "Анализ (перечитано папок: %zu из %zu%s)",
+                  stats.directories_reread, stats.directories_total,
+                  stats.resumed ? ", продолжено с контрольной точки" : "");
+    show_results_view(win, title, results);
+}
+
+// Сканирование папки с использованием сохранённого снимка (хэши из него переиспользуются)
+ScanSnapshot scan_with_cached_snapshot(const fs::path& directory, const ScanMatcher& matcher) {
+    ScanSnapshot previous;
+    bool has_previous = load_snapshot(default_snapshot_path(directory), previous);
+    // Размер и время каждого элемента читаются заново: снимок даёт только список имён
+    // неизменившихся папок и хэши файлов с теми же размером и временем
+    return scan_incremental(directory, has_previous ? &previous : nullptr, matcher, nullptr, fs::path(),
+                            SnapshotReuse::Names);
+}
+
+// Знак записи сравнения: '-' только в A, '+' только в B, '!' различаются, '=' совпадают
+char compare_mark(CompareStatus status) {
+    switch (status) {
+        case CompareStatus::OnlyInA: return '-';
+        case CompareStatus::OnlyInB: return '+';
+        case CompareStatus::Differs: return '!';
+        case CompareStatus::Same: break;
+    }
+    return '=';
+}
+
+// Функция для сравнения текущей папки с другой (например, с резервной копией)
+void compare_with_directory(WINDOW* win) {
+    int y = directory_contents.size() + 5;
+    std::string other = input_string(win, y, 1, "Сравнить с папкой: ");
+    if (other.empty()) {
+        return;
+    }
+    if (!fs::is_directory(other)) {
+        mvwprintw(win, y + 1, 1, "Ошибка: '%s' не является папкой.", other.c_str());
+        wrefresh(win);
+        getch();
+        return;
+    }
+    mvwprintw(win, y + 1, 1, "Идет сравнение...");
+    wrefresh(win);
+
+    ScanSnapshot a = scan_with_cached_snapshot(current_directory, scan_matcher);
+    ScanSnapshot b = scan_with_cached_snapshot(other, scan_matcher);
+    CompareStats stats;
+    auto entries = compare_trees(a, b, CompareOptions(), &stats);
+    save_snapshot(a, default_snapshot_path(current_directory));
+    save_snapshot(b, default_snapshot_path(other));
+
+    AnalysisResults results;
+    char line[512];
+    std::snprintf(line, sizeof(line), "Совпадают: %zu, различаются: %zu, только здесь: %zu, только там: %zu",
+                  stats.same, stats.differs, stats.only_in_a, stats.only_in_b);
+    results.summary.push_back(line);
+    std::snprintf(line, sizeof(line), "Сравнено по содержимому: %zu пар (прочитано файлов: %zu, хэшей из снимков: %zu)",
+                  stats.pairs_hashed, stats.files_hashed, stats.hashes_reused);
+    results.summary.push_back(line);
+    for (const auto& entry : entries) {
+        if (entry.status != CompareStatus::Same) {
+            results.summary.push_back(std::string(1, compare_mark(entry.status)) + " " + entry.path +
+                                      (entry.type == EntryType::Directory ? "/" : ""));
+        }
+    }
+    show_results_view(win, "Сравнение с " + other, results);
+}
+
+// Функция для наблюдения за текущей папкой: результаты анализа остаются актуальными
+// и обновляются по событиям файловой системы, без повторного Ctrl+A
+void watch_current_directory(WINDOW* win) {
+    wclear(win);
+    box(win, 0, 0);
+    mvwprintw(win, 1, 1, "Наблюдение за папкой: %s", current_directory.c_str());
+    mvwprintw(win, 2, 1, "Идет анализ...");
+    wrefresh(win);
+
+    take_scan_errors();
+    std::unique_ptr<DirectoryWatcher> watcher;
+    try {
+        watcher = std::make_unique<DirectoryWatcher>(current_directory, scan_matcher, 30);
+    } catch (const std::exception& e) {
+        mvwprintw(win, 3, 1, "Ошибка: %s", e.what());
+        wrefresh(win);
+        getch();
+        return;
+    }
+    std::vector<ScanError> errors = take_scan_errors();
+    WatchUpdate last_update;
+
+    auto draw = [&]() {
+        const WatchResults& results = watcher->results();
+        wclear(win);
+        box(win, 0, 0);
+        int y = 1;
+        mvwprintw(win, y++, 1, "Наблюдение за папкой: %s", current_directory.c_str());
+        mvwprintw(win, y++, 1, "Папок под наблюдением: %zu", watcher->watched_directories());
+        if (watcher->unwatched_directories() > 0) {
+            wprintw(win, " (без наблюдения: %zu — исчерпан лимит inotify)", watcher->unwatched_directories());
+        }
+        y++;
+        mvwprintw(win, y++, 1, "Неиспользуемых файлов (более 30 дней): %zu", results.unused_files.size());
+        mvwprintw(win, y++, 1, "Групп дубликатов: %zu", results.duplicate_groups.size());
+        mvwprintw(win, y++, 1, "Пустых папок: %zu", results.empty_dirs.size());
+        if (!errors.empty()) {
+            mvwprintw(win, y++, 1, "Пропущено из-за ошибок: %zu", errors.size());
+        }
+        y++;
+        char time_text[16];
+        std::strftime(time_text, sizeof(time_text), "%H:%M:%S", std::localtime(&results.updated_at));
+        if (results.generation == 0) {
+            mvwprintw(win, y++, 1, "Анализ выполнен в %s, ожидание изменений...", time_text);
+        } else {
+            mvwprintw(win, y++, 1, "Обновление %llu в %s: событий %zu, перечитано папок %zu%s",
+                      static_cast<unsigned long long>(results.generation), time_text, last_update.events,
+                      last_update.directories_refreshed,
+                      last_update.full_rescan ? " (очередь событий переполнилась — дерево пересканировано)" : "");
+        }
+        mvwprintw(win, getmaxy(win) - 2, 1, "Enter: Результаты | q: Выход из наблюдения");
+        wrefresh(win);
+    };
+
+    // Ожидание одновременно клавиш и событий inotify
+    wtimeout(win, 0);
+    bool running = true;
+    while (running) {
+        draw();
+        struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {watcher->fd(), POLLIN, 0}};
+        int ready = ::poll(fds, 2, watcher->poll_timeout_ms());
+        if (ready < 0) {
+            continue; // Прервано сигналом (например, при изменении размера терминала)
+        }
+        if (ready == 0 || (fds[1].revents & POLLIN)) { // По таймауту — файлы перешли порог давности
+            watcher->update(&last_update);
+            auto new_errors = take_scan_errors();
+            errors.insert(errors.end(), new_errors.begin(), new_errors.end());
+        }
+        int ch;
+        while (running && (ch = wgetch(win)) != ERR) {
+            if (ch == 'q' || ch == 'Q') {
+                running = false;
+            } else if (ch == '\n') {
+                const WatchResults& current = watcher->results();
+                AnalysisResults results;
+                results.days_threshold = 30;
+                results.unused_files = current.unused_files;
+                results.duplicate_groups = current.duplicate_groups;
+                results.duplicate_info = current.group_info;
+                results.empty_dirs = current.empty_dirs;
+                results.summary = format_type_stats("Дубликаты по типам (лишние копии):",
+                                                    summarize_duplicates_by_type(current.duplicate_groups,
+                                                                                 current.group_types,
+                                                                                 current.group_info));
+                for (const auto& error : errors) {
+                    results.summary.push_back("  " + error.path + ": " + error.reason);
+                }
+                wtimeout(win, -1);
+                show_results_view(win, "Наблюдение (состояние на момент открытия)", results);
+                wtimeout(win, 0);
+            }
+        }
+    }
+    wtimeout(win, -1);
+    save_snapshot(watcher->snapshot(), default_snapshot_path(current_directory));
+}
+
+// Вывод журнала ошибок анализа: пропущенные файлы и папки не прерывают анализ
+void report_scan_errors() {
+    auto errors = take_scan_errors();
+    if (errors.empty()) {
+        return;
+    }
+    std::cerr << "Пропущено из-за ошибок: " << errors.size() << "\n";
+    for (const auto& error : errors) {
+        std::cerr << "  " << error.path << ": " << error.reason << "\n";
+    }
+}
+
+// Запрос остановки наблюдения из обработчика сигнала
+volatile std::sig_atomic_t watch_stop_requested = 0;
+
+void stop_watching(int) {
+    watch_stop_requested = 1;
+}
+
+// Вывод текущего состояния наблюдения
+void print_watch_state(const DirectoryWatcher& watcher, const WatchUpdate& update, bool full) {
+    const WatchResults& results = watcher.results();
+    char time_text[16];
+    std::strftime(time_text, sizeof(time_text), "%H:%M:%S", std::localtime(&results.updated_at));
+    std::cout << "[" << time_text << "] обновление " << results.generation
+              << ": неиспользуемых файлов " << results.unused_files.size()
+              << ", групп дубликатов " << results.duplicate_groups.size()
+              << ", пустых папок " << results.empty_dirs.size();
+    if (results.generation > 0) {
+        std::cout << " (событий " << update.events << ", перечитано папок " << update.directories_refreshed
+                  << (update.full_rescan ? ", очередь переполнилась" : "") << ")";
+    }
+    std::cout << "\n";
+    if (full) {
+        for (const auto& file : results.unused_files) {
+            std::cout << "  unused " << file.path << " (" << file.size << " байт)\n";
+        }
+        for (const auto& group : results.duplicate_groups) {
+            for (const auto& file : group) {
+                std::cout << "  dup " << file.string() << "\n";
+            }
+            std::cout << "  ----\n";
+        }
+        for (const auto& dir : results.empty_dirs) {
+            std::cout << "  empty " << dir.string() << "\n";
+        }
+    }
+    std::cout << std::flush;
+}
+
+// Вывод справки по режиму командной строки
+void print_usage(const char* program) {
+    std::cout << "Использование:\n"
+              << "  " << program << "                      интерактивный режим\n"
+              << "  " << program << " --analyze <папка>    анализ без интерфейса\n"
+              << "  " << program << " --changes <папка>    изменения с последнего сохранённого снимка\n"
+              << "  " << program << " --report <папка>     сводка и самые большие неиспользуемые файлы\n"
+              << "  " << program << " --tier-out <папка> --pack <архив> [--compress] [--remove]\n"
+              << "                       упаковка неиспользуемых файлов в архив\n"
+              << "  " << program << " --pack-list <архив>  содержимое архива\n"
+              << "  " << program << " --compare <A> <B>    сравнение двух деревьев (например, с резервной копией)\n"
+              << "  " << program << " --pack-restore <архив> <запись> <файл>  восстановление файла из архива\n"
+              << "  " << program << " --replace <образец> <замена> <файл>...  потоковая замена в файлах\n"
+              << "  " << program << " --watch <папка>      анализ с обновлением по событиям файловой системы (до Ctrl+C)\n"
+              << "Параметры:\n"
+              << "  --rules \"<правила>\"  например \"exclude=.git,node_modules min-size=1K type=image xdev\"\n"
+              << "  --days <N>            порог неиспользования в днях (по умолчанию 30)\n"
+              << "  --memory-budget <МБ>  поиск дубликатов с ограничением памяти и сбросом на диск\n"
+              << "  --spill-dir <папка>   папка для временных серий (по умолчанию системная)\n"
+              << "  --incremental         анализ по снимку: перечитываются только изменённые папки\n"
+              << "  --io \"<ограничения>\"  например \"background nocache bw=20M iops=200\"\n"
+              << "  --top <K>             размер списка самых больших файлов в сводке (по умолчанию 100)\n"
+              << "  --time <поле>         mtime, atime или ctime для сводки (по умолчанию mtime)\n"
+              << "  --verify              при сравнении проверять содержимое и у файлов с одинаковым временем\n"
+              << "  --threads <N>         потоки хэширования при сравнении (по умолчанию по числу процессоров)\n"
+              << "  --all                 при сравнении выводить и совпадающие элементы,\n"
+              << "                        при наблюдении — полные списки после каждого обновления\n"
+              << "  --regex               образец замены — регулярное выражение ($1, $& в замене)\n"
+              << "  --ignore-case         замена без учёта регистра\n"
+              << "В интерактивном режиме F12 показывает задержки интерфейса; если задана переменная\n"
+              << "ANALIZATOR_LATENCY_LOG, при выходе они дописываются в указанный файл.\n"
+              << "Типы для правила type=: text, image, audio, video, archive, document, executable, database, unknown\n";
+}
+
+// Режим командной строки
+int run_command_line(int argc, char* argv[]) {
+    std::string command;
+    std::vector<std::string> paths;
+    std::string rules_spec;
+    int days = 30;
+    std::size_t memory_budget = 0;
+    fs::path spill_dir = fs::temp_directory_path();
+    bool incremental = false;
+    std::string io_spec;
+    std::size_t top_k = 100;
+    TimeField time_field = TimeField::Modified;
+    fs::path pack_path;
+    bool compress = false;
+    bool remove_originals = false;
+    CompareOptions compare_options;
+    bool list_all = false;
+    redactor::ReplaceOptions replace_options;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--rules" && i + 1 < argc) {
+            rules_spec = argv[++i];
+        } else if (arg == "--days" && i + 1 < argc) {
+            days = std::atoi(argv[++i]);
+        } else if (arg == "--memory-budget" && i + 1 < argc) {
+            memory_budget = static_cast<std::size_t>(std::atol(argv[++i])) << 20;
+        } else if (arg == "--spill-dir" && i + 1 < argc) {
+            spill_dir = argv[++i];
+        } else if (arg == "--io" && i + 1 < argc) {
+            io_spec = argv[++i];
+        } else if (arg == "--top" && i + 1 < argc) {
+            top_k = static_cast<std::size_t>(std::atol(argv[++i]));
+        } else if (arg == "--time" && i + 1 < argc) {
+            if (!parse_time_field(argv[++i], time_field)) {
+                std::cerr << "Ошибка: неизвестное поле времени " << argv[i] << std::endl;
+                return 2;
+            }
+        } else if (arg == "--pack" && i + 1 < argc) {
+            pack_path = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            compare_options.threads = static_cast<std::size_t>(std::atol(argv[++i]));
+        } else if (arg == "--verify") {
+            compare_options.verify_content = true;
+        } else if (arg == "--all") {
+            list_all = true;
+        } else if (arg == "--compress") {
+            compress = true;
+        } else if (arg == "--remove") {
+            remove_originals = true;
+        } else if (arg == "--incremental") {
+            incremental = true;
+        } else if (arg == "--regex") {
+            replace_options.regex = true;
+        } else if (arg == "--ignore-case") {
+            replace_options.ignore_case = true;
+        } else if (arg.rfind("--", 0) == 0 && command.empty()) {
+            command = arg;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    ScanRules rules;
+    std::string error;
+    if (!parse_scan_rules(rules_spec, rules, error)) {
+        std::cerr << "Ошибка: " << error << std::endl;
+        return 2;
+    }
+    ScanMatcher matcher(rules);
 
-    mvwprintw(win, y++, 1, "Результаты анализа:");
-    mvwprintw(win, y++, 1, "Файлы, не использованные более 30 дней:");
-    for (const auto& file : unused_files) {
-        mvwprintw(win, y++, 1, "  %s (Размер: %zu байт, Последнее использование: %s)",
-                  file.name.c_str(), file.size, ctime(&file.last_used));
+    IoLimits limits;
+    if (!parse_io_limits(io_spec, limits, error)) {
+        std::cerr << "Ошибка: " << error << std::endl;
+        return 2;
     }
-    mvwprintw(win, y++, 1, "Дубликаты файлов:");
-    for (const auto& group : duplicate_files) {
-        for (const auto& file : group) {
-            mvwprintw(win, y++, 1, "  %s", file.c_str());
+    if (int io_error = set_io_limits(limits)) {
+        std::cerr << "Предупреждение: не удалось изменить приоритет: " << redactor::error_message(io_error) << std::endl;
+    }
+
+    if (command == "--report" && paths.size() == 1) {
+        UnusedFilesReport report = build_unused_report(paths[0], days, top_k, time_field, 20, matcher);
+        for (const auto& line : format_report_summary(report)) {
+            std::cout << line << "\n";
         }
+        std::cout << "Самые большие файлы:\n";
+        for (const auto& file : report.largest) {
+            std::cout << "  " << file.size << "  " << file.path << "\n";
+        }
+        return 0;
     }
-    mvwprintw(win, y++, 1, "Пустые папки:");
-    for (const auto& dir : empty_dirs) {
-        mvwprintw(win, y++, 1, "  %s", dir.c_str());
+
+    if (command == "--tier-out" && paths.size() == 1 && !pack_path.empty()) {
+        std::vector<fs::path> files;
+        for (const auto& file : find_unused_files_recursive(paths[0], days, matcher)) {
+            files.push_back(file.path);
+        }
+        TierOutResult result;
+        int error = tier_out(files, paths[0], pack_path, compress, remove_originals, &result);
+        if (error != 0) {
+            std::cerr << "Ошибка упаковки: " << redactor::error_message(error) << std::endl;
+            return 1;
+        }
+        std::cout << "Упаковано файлов: " << result.packed << ", ошибок: " << result.failed
+                  << ", оставлено изменившихся: " << result.kept
+                  << ", байт: " << result.bytes_in << " -> " << result.bytes_out << "\n";
+        return 0;
+    }
+
+    if (command == "--compare" && paths.size() == 2) {
+        ScanSnapshot a = scan_with_cached_snapshot(paths[0], matcher);
+        ScanSnapshot b = scan_with_cached_snapshot(paths[1], matcher);
+        CompareStats stats;
+        for (const auto& entry : compare_trees(a, b, compare_options, &stats)) {
+            if (list_all || entry.status != CompareStatus::Same) {
+                std::cout << compare_mark(entry.status) << " " << entry.path
+                          << (entry.type == EntryType::Directory ? "/" : "") << "\n";
+            }
+        }
+        save_snapshot(a, default_snapshot_path(paths[0]));
+        save_snapshot(b, default_snapshot_path(paths[1]));
+        std::cout << "Совпадают: " << stats.same << ", различаются: " << stats.differs
+                  << ", только в A: " << stats.only_in_a << ", только в B: " << stats.only_in_b << "\n"
+                  << "Сравнено по содержимому: " << stats.pairs_hashed << " пар (прочитано файлов: "
+                  << stats.files_hashed << ", хэшей из снимков: " << stats.hashes_reused << ")\n";
+        report_scan_errors();
+        return stats.differs + stats.only_in_a + stats.only_in_b == 0 ? 0 : 1;
+    }
+
+    if (command == "--pack-list" && paths.size() == 1) {
+        std::vector<PackEntry> entries;
+        int error = list_pack(paths[0], entries);
+        if (error != 0) {
+            std::cerr << "Ошибка чтения архива: " << redactor::error_message(error) << std::endl;
+            return 1;
+        }
+        for (const auto& entry : entries) {
+            std::cout << entry.original_size << "  " << entry.stored_size << "  " << entry.path << "\n";
+        }
+        return 0;
+    }
+
+    if (command == "--pack-restore" && paths.size() == 3) {
+        int error = restore_from_pack(paths[0], paths[1], paths[2]);
+        if (error != 0) {
+            std::cerr << "Ошибка восстановления: " << redactor::error_message(error) << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (command == "--replace" && paths.size() >= 3) {
+        if (redactor::StreamReplacer(paths[0], paths[1], replace_options).error() != 0) {
+            std::cerr << "Ошибка: некорректный образец " << paths[0] << std::endl;
+            return 2;
+        }
+        int exit_code = 0;
+        for (std::size_t i = 2; i < paths.size(); ++i) {
+            std::uint64_t matches = 0;
+            int error = redactor::replace_in_file(paths[i], paths[0], paths[1], replace_options, &matches);
+            if (error != 0) {
+                std::cerr << paths[i] << ": " << redactor::error_message(error) << std::endl;
+                exit_code = 1;
+                continue;
+            }
+            std::cout << paths[i] << ": " << matches << "\n";
+        }
+        return exit_code;
+    }
+
+    if (command == "--watch" && paths.size() == 1) {
+        std::unique_ptr<DirectoryWatcher> watcher;
+        try {
+            watcher = std::make_unique<DirectoryWatcher>(paths[0], matcher, days);
+        } catch (const std::exception& e) {
+            std::cerr << "Ошибка: " << e.what() << std::endl;
+            return 1;
+        }
+        std::signal(SIGINT, stop_watching);
+        std::signal(SIGTERM, stop_watching);
+        WatchUpdate update;
+        do {
+            print_watch_state(*watcher, update, list_all);
+            report_scan_errors();
+            struct pollfd pfd = {watcher->fd(), POLLIN, 0};
+            while (!watch_stop_requested && ::poll(&pfd, 1, watcher->poll_timeout_ms()) >= 0 &&
+                   !watcher->update(&update)) {
+            }
+        } while (!watch_stop_requested);
+        return save_snapshot(watcher->snapshot(), default_snapshot_path(paths[0])) ? 0 : 1;
+    }
+
+    if (command == "--changes" && paths.size() == 1) {
+        ScanSnapshot previous;
+        if (!load_snapshot(default_snapshot_path(paths[0]), previous)) {
+            std::cerr << "Снимок для " << paths[0] << " не найден: выполните --analyze --incremental" << std::endl;
+            return 1;
+        }
+        // Правки файлов на месте не меняют время папки, поэтому размеры и время читаются заново
+        ScanSnapshot current = scan_incremental(paths[0], &previous, matcher, nullptr, fs::path(), SnapshotReuse::Names);
+        for (const auto& change : diff_snapshots(previous, current)) {
+            char mark = change.kind == ChangeKind::Added ? '+' : change.kind == ChangeKind::Removed ? '-' : '~';
+            std::cout << mark << " " << change.path << (change.type == EntryType::Directory ? "/" : "") << "\n";
+        }
+        return 0;
+    }
+
+    if (command == "--analyze" && paths.size() == 1 && incremental) {
+        fs::path snapshot_path = default_snapshot_path(paths[0]);
+        fs::path checkpoint_path = default_checkpoint_path(paths[0]);
+        ScanSnapshot previous;
+        bool has_previous = load_snapshot(snapshot_path, previous);
+        RescanStats stats;
+        ScanSnapshot snapshot = scan_incremental(paths[0], has_previous ? &previous : nullptr, matcher, &stats,
+                                                 checkpoint_path);
+
+        if (stats.resumed) {
+            std::cout << "Анализ продолжен с контрольной точки\n";
+        }
+        std::cout << "Перечитано папок: " << stats.directories_reread << " из " << stats.directories_total << "\n";
+        std::cout << "Файлы, не использованные более " << days << " дней:\n";
+        for (const auto& file : find_unused_files_in_snapshot(snapshot, days, matcher)) {
+            std::cout << "  " << file.path << " (" << file.size << " байт)\n";
+        }
+        std::cout << "Дубликаты файлов:\n";
+        std::vector<FileType> group_types;
+        std::vector<DuplicateGroupInfo> group_info;
+        auto duplicates = find_duplicate_files_in_snapshot(snapshot, matcher, &group_types, checkpoint_path, &group_info);
+        for (std::size_t i = 0; i < duplicates.size(); ++i) {
+            for (const auto& file : duplicates[i]) {
+                std::cout << "  " << file.string() << "\n";
+            }
+            std::cout << "  ---- " << file_type_name(group_types[i]) << "\n";
+        }
+        for (const auto& line : format_type_stats("Дубликаты по типам (лишние копии):",
+                                                  summarize_duplicates_by_type(duplicates, group_types, group_info))) {
+            std::cout << line << "\n";
+        }
+        std::cout << "Пустые папки:\n";
+        for (const auto& dir : find_empty_directories_in_snapshot(snapshot)) {
+            std::cout << "  " << dir.string() << "\n";
+        }
+        if (!save_snapshot(snapshot, snapshot_path)) {
+            return 1;
+        }
+        std::error_code ec;
+        fs::remove(checkpoint_path, ec);
+        report_scan_errors();
+        return 0;
+    }
+
+    if (command == "--analyze" && paths.size() == 1) {
+        // Результаты выводятся по мере нахождения, без накопления в памяти
+        const fs::path directory = paths[0];
+        std::cout << "Файлы, не использованные более " << days << " дней:\n";
+        scan_unused_files(directory, days, [](const FileInfo& file) {
+            std::cout << "  " << file.path << " (" << file.size << " байт)\n";
+            return true;
+        }, matcher);
+        std::cout << "Дубликаты файлов:\n";
+        auto print_group = [](const std::vector<fs::path>& group) {
+            for (const auto& file : group) {
+                std::cout << "  " << file.string() << "\n";
+            }
+            std::cout << "  ----\n";
+            return true;
+        };
+        if (memory_budget > 0) {
+            find_duplicate_files_external(directory, memory_budget, print_group, spill_dir, matcher);
+        } else {
+            scan_duplicate_files(directory, print_group, matcher);
+        }
+        std::cout << "Пустые папки:\n";
+        scan_empty_directories(directory, [](const fs::path& dir) {
+            std::cout << "  " << dir.string() << "\n";
+            return true;
+        }, matcher);
+        report_scan_errors();
+        return 0;
+    }
+
+    print_usage(argv[0]);
+    return 2;
+}
+
+// Функция для копирования или перемещения выбранных (или отмеченных) элементов
+void transfer_selected_items(WINDOW* win, bool move) {
+    std::vector<std::string> names(marked_items.begin(), marked_items.end());
+    if (names.empty()) {
+        if (directory_contents[selected_index].name == "..") {
+            return;
+        }
+        names.push_back(directory_contents[selected_index].name);
+    }
+
+    int y = directory_contents.size() + 5;
+    std::string target = input_string(win, y, 1, move ? "Переместить в: " : "Копировать в: ");
+    if (target.empty()) {
+        return;
+    }
+    fs::path target_path = fs::path(target).is_absolute() ? fs::path(target) : fs::path(current_directory) / target;
+    // Несколько элементов или существующая папка — элементы кладутся внутрь неё;
+    // для нескольких элементов недостающая папка назначения создаётся
+    bool into_directory = names.size() > 1 || fs::is_directory(target_path);
+    std::error_code target_ec;
+    if (names.size() > 1 && !fs::is_directory(target_path) && !fs::create_directories(target_path, target_ec)) {
+        mvwprintw(win, y + 1, 1, "Ошибка: не удалось создать папку '%s' (%s)", target_path.c_str(),
+                  target_ec ? target_ec.message().c_str() : redactor::error_message(ENOTDIR).c_str());
+        wrefresh(win);
+        getch();
+        return;
+    }
+
+    int last_percent = -1;
+    auto progress = [&](std::uint64_t copied, std::uint64_t total) {
+        int percent = total > 0 ? static_cast<int>(copied * 100 / total) : 100;
+        if (percent != last_percent) {
+            last_percent = percent;
+            mvwprintw(win, y + 1, 1, "%s: %3d%% (%llu из %llu МБ)", move ? "Перемещение" : "Копирование", percent,
+                      static_cast<unsigned long long>(copied >> 20), static_cast<unsigned long long>(total >> 20));
+            wrefresh(win);
+        }
+        return true;
+    };
+
+    std::size_t failed = 0;
+    int last_error = 0;
+    for (const auto& name : names) {
+        fs::path source = fs::path(current_directory) / name;
+        fs::path destination = into_directory ? target_path / name : target_path;
+        last_percent = -1;
+        int error = 0;
+        if (move) {
+            error = redactor::move_path(source, destination, progress);
+        } else if (fs::is_directory(fs::symlink_status(source))) {
+            error = redactor::copy_tree(source, destination, progress);
+        } else {
+            error = redactor::copy_file(source, destination, progress);
+        }
+        if (error != 0) {
+            failed++;
+            last_error = error;
+        }
+    }
+
+    if (failed == 0) {
+        mvwprintw(win, y + 2, 1, "Готово: %zu элементов.", names.size());
+    } else {
+        mvwprintw(win, y + 2, 1, "Ошибок: %zu из %zu (%s)", failed, names.size(), redactor::error_message(last_error).c_str());
+    }
+    marked_items.clear();
+    update_directory_contents();
+    if (selected_index >= directory_contents.size()) {
+        selected_index = directory_contents.size() - 1;
+    }
+    wrefresh(win);
+    getch();
+}
+
+// Функция для поиска и замены в выбранных (или отмеченных) файлах
+void replace_in_selected_files(WINDOW* win) {
+    std::vector<std::string> names(marked_items.begin(), marked_items.end());
+    if (names.empty()) {
+        if (directory_contents[selected_index].name == "..") {
+            return;
+        }
+        names.push_back(directory_contents[selected_index].name);
+    }
+
+    int y = directory_contents.size() + 5;
+    std::string pattern;
+    std::string replacement;
+    redactor::ReplaceOptions options;
+    if (!prompt_replace(win, y, pattern, replacement, options)) {
+        return;
+    }
+
+    int last_percent = -1;
+    std::string current_name;
+    auto progress = [&](std::uint64_t done, std::uint64_t total) {
+        int percent = total > 0 ? static_cast<int>(done * 100 / total) : 100;
+        if (percent != last_percent) {
+            last_percent = percent;
+            mvwprintw(win, y + 2, 1, "Замена в %s: %3d%% (%llu из %llu МБ)", current_name.c_str(), percent,
+                      static_cast<unsigned long long>(done >> 20), static_cast<unsigned long long>(total >> 20));
+            wclrtoeol(win);
+            wrefresh(win);
+        }
+        return true;
+    };
+
+    std::size_t failed = 0;
+    int last_error = 0;
+    std::uint64_t total_matches = 0;
+    std::size_t changed_files = 0;
+    for (const auto& name : names) {
+        current_name = name;
+        last_percent = -1;
+        std::uint64_t matches = 0;
+        int error = redactor::replace_in_file(fs::path(current_directory) / name, pattern, replacement, options,
+                                              &matches, progress);
+        if (error != 0) {
+            failed++;
+            last_error = error;
+        } else if (matches > 0) {
+            changed_files++;
+            total_matches += matches;
+        }
+    }
+
+    if (failed == 0) {
+        mvwprintw(win, y + 3, 1, "Заменено: %llu в %zu из %zu файлов.",
+                  static_cast<unsigned long long>(total_matches), changed_files, names.size());
+    } else {
+        mvwprintw(win, y + 3, 1, "Заменено: %llu в %zu файлах, ошибок: %zu (%s)",
+                  static_cast<unsigned long long>(total_matches), changed_files, failed,
+                  redactor::error_message(last_error).c_str());
+    }
+    marked_items.clear();
+    wrefresh(win);
+    getch();
+}
+
+// Функция для построения сводки по давно не использовавшимся файлам
+void show_unused_report(WINDOW* win) {
+    wclear(win);
+    box(win, 0, 0);
+    mvwprintw(win, 1, 1, "Сводка по папке: %s", current_directory.c_str());
+    mvwprintw(win, 2, 1, "Идет анализ...");
+    wrefresh(win);
+
+    UnusedFilesReport report = build_unused_report(current_directory, 30, 100, TimeField::Modified, 20, scan_matcher);
+    AnalysisResults results;
+    results.days_threshold = 30;
+    results.summary = format_report_summary(report);
+    results.unused_files = std::move(report.largest);
+    show_results_view(win, "Сводка и 100 самых больших неиспользуемых файлов", results);
+}
+
+// Функция для упаковки давно не использовавшихся файлов в архив
+void pack_unused_files(WINDOW* win) {
+    int y = directory_contents.size() + 5;
+    std::string pack_name = input_string(win, y, 1, "Имя архива (в текущей папке): ");
+    if (pack_name.empty()) {
+        return;
+    }
+    mvwprintw(win, y + 1, 1, "Удалить исходные файлы после упаковки? (y/n)");
+    wrefresh(win);
+    int confirm = getch();
+    bool remove_originals = confirm == 'y' || confirm == 'Y';
+
+    mvwprintw(win, y + 2, 1, "Поиск неиспользуемых файлов...");
+    wrefresh(win);
+    fs::path pack_path = fs::path(current_directory) / pack_name;
+    std::vector<fs::path> files;
+    for (const auto& file : find_unused_files_recursive(current_directory, 30, scan_matcher)) {
+        if (file.path != pack_path.string()) {
+            files.push_back(file.path);
+        }
+    }
+
+    TierOutResult result;
+    int error = tier_out(files, current_directory, pack_path, true, remove_originals, &result,
+                         [&](std::size_t done, std::size_t total) {
+                             mvwprintw(win, y + 2, 1, "Упаковано: %zu из %zu", done, total);
+                             wclrtoeol(win);
+                             wrefresh(win);
+                         });
+    if (error != 0) {
+        mvwprintw(win, y + 3, 1, "Ошибка упаковки: %s", redactor::error_message(error).c_str());
+    } else {
+        mvwprintw(win, y + 3, 1, "Готово: %zu файлов, ошибок %zu, оставлено изменившихся %zu, %llu -> %llu байт.",
+                  result.packed, result.failed, result.kept,
+                  static_cast<unsigned long long>(result.bytes_in), static_cast<unsigned long long>(result.bytes_out));
+    }
+    update_directory_contents();
+    if (selected_index >= directory_contents.size()) {
+        selected_index = directory_contents.size() - 1;
+    }
+    wrefresh(win);
+    getch();
+}
+
+// Функция для отображения изменений с последнего анализа
+void show_changes_since_last_scan(WINDOW* win) {
+    wclear(win);
+    box(win, 0, 0);
+    int y = 1;
+    mvwprintw(win, y++, 1, "Изменения с последнего анализа: %s", current_directory.c_str());
+
+    ScanSnapshot previous;
+    if (!load_snapshot(default_snapshot_path(current_directory), previous)) {
+        mvwprintw(win, y++, 1, "Снимок не найден: сначала выполните анализ (Ctrl+A).");
+    } else {
+        ScanSnapshot current = scan_incremental(current_directory, &previous, scan_matcher, nullptr, fs::path(),
+                                                SnapshotReuse::Names);
+        auto changes = diff_snapshots(previous, current);
+        int max_rows = LINES - 5;
+        for (std::size_t i = 0; i < changes.size(); ++i) {
+            if (y >= max_rows) {
+                mvwprintw(win, y++, 1, "... и ещё %zu", changes.size() - i);
+                break;
+            }
+            const char* mark = changes[i].kind == ChangeKind::Added ? "+" : changes[i].kind == ChangeKind::Removed ? "-" : "~";
+            mvwprintw(win, y++, 1, "  %s %s%s", mark, changes[i].path.c_str(),
+                      changes[i].type == EntryType::Directory ? "/" : "");
+        }
+        if (changes.empty()) {
+            mvwprintw(win, y++, 1, "Изменений нет.");
+        }
     }
     mvwprintw(win, y++, 1, "Нажмите любую клавишу для возврата...");
     wrefresh(win);
     getch();
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        return run_command_line(argc, argv);
+    }
+
     setlocale(LC_ALL, ""); // Поддержка русского языка
     initscr();
     cbreak();
     noecho();
     keypad(stdscr, TRUE);
 
-    update_directory_contents();
+    change_directory(current_directory);
 
     WINDOW* win = newwin(LINES - 1, COLS, 0, 0);
     keypad(win, TRUE); // Включаем обработку специальных клавиш для окна
@@ -351,8 +1306,13 @@ int main() {
 
     while (true) {
         show_main_interface(win);
+        latency_event_done();
 
         int ch = wgetch(win);
+        latency_key_received(UiLoop::Browser);
+        if (is_modal_key(ch)) {
+            latency_discard_event();
+        }
         switch (ch) {
             case KEY_UP:
                 if (selected_index > 0) selected_index--;
@@ -362,43 +1322,72 @@ int main() {
                 break;
             case 10: // Enter
                 {
-                    std::string selected_item = directory_contents[selected_index];
-                    std::string new_path = current_directory + "/" + selected_item;
-                    if (selected_item == "..") {
-                        current_directory = fs::path(current_directory).parent_path().string();
-                        update_directory_contents();
-                        selected_index = 0;
-                    } else if (fs::is_directory(new_path)) {
-                        current_directory = new_path;
-                        update_directory_contents();
-                        selected_index = 0;
-                    } else if (fs::exists(new_path)) {
+                    const auto& selected_item = directory_contents[selected_index];
+                    std::string new_path = (fs::path(current_directory) / selected_item.name).string();
+                    if (selected_item.name == "..") {
+                        change_directory(fs::path(current_directory).parent_path().string());
+                    } else if (selected_item.is_directory) {
+                        change_directory(new_path);
+                    } else {
+                        latency_discard_event(); // Время в редакторе учитывается его собственным циклом
                         edit_file_content(win, new_path);
+                        update_directory_contents(); // Редактор мог сохранить файл или оставить файл восстановления
                         show_main_interface(win); // Обновляем главное меню после выхода из редактора
                     }
                 }
                 break;
-            case KEY_DC: // Delete
+            case ' ': // Отметить элемент для пакетной операции
                 {
-                    std::string selected_item = directory_contents[selected_index];
-                    if (selected_item != "..") {
-                        fs::path item_path = current_directory + "/" + selected_item;
-                        mvwprintw(win, LINES - 3, 1, "Удалить '%s'? (y/n)", selected_item.c_str());
+                    const auto& item = directory_contents[selected_index];
+                    if (item.name != "..") {
+                        if (!marked_items.erase(item.name)) {
+                            marked_items.insert(item.name);
+                        }
+                        if (selected_index < directory_contents.size() - 1) selected_index++;
+                    }
+                }
+                break;
+            case KEY_F(12): // Отладочная сводка задержек интерфейса
+                latency_overlay = !latency_overlay;
+                break;
+            case KEY_F(5): // Копирование
+                transfer_selected_items(win, false);
+                break;
+            case KEY_F(6): // Перемещение
+                transfer_selected_items(win, true);
+                break;
+            case KEY_DC: // Delete
+                if (!marked_items.empty()) {
+                    // Пакетное удаление отмеченных элементов
+                    mvwprintw(win, LINES - 3, 1, "Удалить отмеченные элементы (%zu)? (y/n)", marked_items.size());
+                    wrefresh(win);
+                    int confirm = getch();
+                    if (confirm == 'y' || confirm == 'Y') {
+                        std::vector<std::string> names(marked_items.begin(), marked_items.end());
+                        auto results = redactor::delete_entries_at(current_dir_handle, names);
+                        size_t failed = std::count_if(results.begin(), results.end(),
+                                                      [](const redactor::BatchResult& r) { return r.error != 0; });
+                        mvwprintw(win, LINES - 2, 1, "Удалено: %zu, ошибок: %zu.", results.size() - failed, failed);
+                        marked_items.clear();
+                        update_directory_contents();
+                        if (selected_index >= directory_contents.size()) {
+                            selected_index = directory_contents.size() - 1;
+                        }
+                    }
+                    wrefresh(win);
+                    getch();
+                } else {
+                    const auto selected_item = directory_contents[selected_index];
+                    if (selected_item.name != "..") {
+                        mvwprintw(win, LINES - 3, 1, "Удалить '%s'? (y/n)", selected_item.name.c_str());
                         wrefresh(win);
                         int confirm = getch();
                         if (confirm == 'y' || confirm == 'Y') {
-                            if (fs::is_directory(item_path)) {
-                                if (redactor::delete_directory(item_path)) {
-                                    mvwprintw(win, LINES - 2, 1, "Папка удалена.");
-                                } else {
-                                    mvwprintw(win, LINES - 2, 1, "Ошибка удаления папки!");
-                                }
+                            int error = redactor::delete_entry_at(current_dir_handle, selected_item.name);
+                            if (error == 0) {
+                                mvwprintw(win, LINES - 2, 1, "%s", selected_item.is_directory ? "Папка удалена." : "Файл удален.");
                             } else {
-                                if (redactor::delete_file(item_path)) {
-                                    mvwprintw(win, LINES - 2, 1, "Файл удален.");
-                                } else {
-                                    mvwprintw(win, LINES - 2, 1, "Ошибка удаления файла!");
-                                }
+                                mvwprintw(win, LINES - 2, 1, "Ошибка удаления: %s", redactor::error_message(error).c_str());
                             }
                             update_directory_contents();
                             if (selected_index >= directory_contents.size()) {
@@ -413,18 +1402,81 @@ int main() {
             case 1: // Ctrl+A (анализ текущей папки)
                 analyze_current_directory(win);
                 break;
+            case 20: // Ctrl+T (сводка по неиспользуемым файлам)
+                show_unused_report(win);
+                break;
+            case 18: // Ctrl+R (изменения с последнего анализа)
+                show_changes_since_last_scan(win);
+                break;
+            case 16: // Ctrl+P (упаковка неиспользуемых файлов)
+                pack_unused_files(win);
+                break;
+            case 11: // Ctrl+K (сравнение с другой папкой)
+                compare_with_directory(win);
+                break;
+            case 5: // Ctrl+E (поиск и замена в файлах)
+                replace_in_selected_files(win);
+                break;
+            case 23: // Ctrl+W (наблюдение за папкой)
+                watch_current_directory(win);
+                update_directory_contents(); // Показываем изменения, замеченные за время наблюдения
+                if (selected_index >= directory_contents.size()) {
+                    selected_index = directory_contents.size() - 1;
+                }
+                break;
+            case 6: // Ctrl+F (правила сканирования)
+                {
+                    int y = directory_contents.size() + 5;
+                    std::string spec = input_string(win, y, 1, "Правила (exclude=.git,node_modules min-size=1K type=image xdev): ");
+                    ScanRules rules;
+                    std::string error;
+                    if (parse_scan_rules(spec, rules, error)) {
+                        scan_rules_spec = spec;
+                        scan_matcher = ScanMatcher(rules); // Компилируем один раз
+                        mvwprintw(win, y + 1, 1, "Правила применены.");
+                    } else {
+                        mvwprintw(win, y + 1, 1, "Ошибка: %s", error.c_str());
+                    }
+                    wrefresh(win);
+                    getch();
+                }
+                break;
+            case 2: // Ctrl+B (фоновый режим анализа)
+                {
+                    int y = directory_contents.size() + 5;
+                    std::string spec = input_string(win, y, 1, "Фоновый режим (background nocache bw=20M iops=200): ");
+                    IoLimits limits;
+                    std::string error;
+                    if (parse_io_limits(spec, limits, error)) {
+                        io_limits_spec = spec;
+                        int io_error = set_io_limits(limits);
+                        if (io_error == 0) {
+                            mvwprintw(win, y + 1, 1, "Ограничения применены.");
+                        } else if (current_io_limits().background) {
+                            mvwprintw(win, y + 1, 1, "Не удалось вернуть прежний приоритет: %s. Процесс остаётся в фоновом режиме.",
+                                      redactor::error_message(io_error).c_str());
+                        } else {
+                            mvwprintw(win, y + 1, 1, "Не удалось понизить приоритет: %s", redactor::error_message(io_error).c_str());
+                        }
+                    } else {
+                        mvwprintw(win, y + 1, 1, "Ошибка: %s", error.c_str());
+                    }
+                    wrefresh(win);
+                    getch();
+                }
+                break;
             case 14: // Ctrl+N (новый файл)
                 {
                     int y = directory_contents.size() + 5; // Учитываем строки подсказок
                     std::string filename = input_string(win, y, 1, "Имя нового файла: ");
-                    fs::path file_path = current_directory + "/" + filename;
-                    if (fs::exists(file_path)) {
+                    int error = redactor::create_file_at(current_dir_handle, filename);
+                    if (error == EEXIST) {
                         mvwprintw(win, y + 1, 1, "Ошибка: Файл '%s' уже существует!", filename.c_str());
-                    } else if (redactor::create_file(file_path)) {
+                    } else if (error == 0) {
                         mvwprintw(win, y + 1, 1, "Файл '%s' создан.", filename.c_str());
                         update_directory_contents();
                     } else {
-                        mvwprintw(win, y + 1, 1, "Ошибка создания файла!");
+                        mvwprintw(win, y + 1, 1, "Ошибка создания файла: %s", redactor::error_message(error).c_str());
                     }
                     wrefresh(win);
                     getch();
@@ -434,14 +1486,14 @@ int main() {
                 {
                     int y = directory_contents.size() + 5;
                     std::string dirname = input_string(win, y, 1, "Имя новой папки: ");
-                    fs::path dir_path = current_directory + "/" + dirname;
-                    if (fs::exists(dir_path)) {
+                    int error = redactor::create_directory_at(current_dir_handle, dirname);
+                    if (error == EEXIST) {
                         mvwprintw(win, y + 1, 1, "Ошибка: Папка '%s' уже существует!", dirname.c_str());
-                    } else if (redactor::create_directory(dir_path)) {
+                    } else if (error == 0) {
                         mvwprintw(win, y + 1, 1, "Папка '%s' создана.", dirname.c_str());
                         update_directory_contents();
                     } else {
-                        mvwprintw(win, y + 1, 1, "Ошибка создания папки!");
+                        mvwprintw(win, y + 1, 1, "Ошибка создания папки: %s", redactor::error_message(error).c_str());
                     }
                     wrefresh(win);
                     getch();
@@ -451,8 +1503,12 @@ int main() {
             case 'Q':
                 delwin(win);
                 endwin();
+                if (const char* log_path = std::getenv("ANALIZATOR_LATENCY_LOG")) {
+                    dump_latency_report(log_path);
+                }
                 return 0;
         }
+        latency_update_done();
     }
 
     delwin(win);
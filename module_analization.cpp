@@ -7,19 +7,46 @@
 #include <unordered_map>
 #include <algorithm>
 #include <fstream>
+#include <mutex>
+#include <map>
+#include <thread>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <sys/stat.h>
+#include "module_external_sort.h"
+#include "module_io_policy.h"
+#include "module_read_scheduler.h"
 
 
 namespace fs = std::filesystem;
 
-// Функция для вычисления хэша файла по его содержимому
-std::string calculate_file_hash(const fs::path& file_path) {
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file) {
-        throw std::runtime_error("Не удалось открыть файл: " + file_path.string());
+// Функция для вычисления 64-битного хэша (FNV-1a) содержимого файла.
+// Файл читается блоками с учётом ограничений ввода-вывода, поэтому расход памяти
+// не зависит от его размера. Тип определяется по тому же чтению, без отдельного запроса.
+std::uint64_t calculate_file_hash64(const fs::path& file_path, FileType* type) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    if (type) {
+        *type = FileType::Unknown; // Для пустого файла блоков не будет
     }
+    bool first_block = true;
+    read_file_blocks(file_path, [&](const char* data, std::size_t count) {
+        if (first_block && type) {
+            *type = classify_sample(data, count);
+        }
+        first_block = false;
+        for (std::size_t i = 0; i < count; ++i) {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 1099511628211ULL;
+        }
+    });
+    return hash;
+}
 
-    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-    return std::to_string(std::hash<std::string>{}(content));
+// Функция для вычисления хэша файла по его содержимому
+std::string calculate_file_hash(const fs::path& file_path) {
+    return std::to_string(calculate_file_hash64(file_path));
 }
 
 // Функция для поиска файлов с одинаковым содержимым
@@ -43,38 +70,355 @@ std::vector<std::vector<fs::path>> find_duplicate_files(const fs::path& director
     return duplicates;
 }
 
-// Рекурсивная функция для поиска файлов с одинаковым содержимым
-std::vector<std::vector<fs::path>> find_duplicate_files_recursive(const fs::path& directory) {
-    std::unordered_map<std::string, std::vector<fs::path>> hash_to_files;
+// Журнал ошибок анализа
+static std::mutex scan_errors_mutex;
+static std::vector<ScanError> scan_errors;
 
-    // Рекурсивно обходим все файлы и подпапки
-    for (const auto& entry : fs::recursive_directory_iterator(directory)) {
-        if (fs::is_regular_file(entry)) {
-            std::string file_hash = calculate_file_hash(entry.path());
-            hash_to_files[file_hash].push_back(entry.path());
+// Потоковый анализ обходит дерево несколько раз, поэтому повторы одной ошибки не записываются
+void record_scan_error(const fs::path& path, const std::string& reason) {
+    std::lock_guard<std::mutex> lock(scan_errors_mutex);
+    for (const auto& error : scan_errors) {
+        if (error.path == path.string() && error.reason == reason) {
+            return;
         }
     }
+    scan_errors.push_back({path.string(), reason});
+}
 
-    std::vector<std::vector<fs::path>> duplicates;
-    for (const auto& [hash, files] : hash_to_files) {
-        if (files.size() > 1) {
-            duplicates.push_back(files);
+void record_scan_error(const fs::path& path, const std::exception& error) {
+    auto system_error = dynamic_cast<const std::system_error*>(&error);
+    record_scan_error(path, system_error ? system_error->code().message() : error.what());
+}
+
+std::vector<ScanError> take_scan_errors() {
+    std::lock_guard<std::mutex> lock(scan_errors_mutex);
+    std::vector<ScanError> errors;
+    errors.swap(scan_errors);
+    return errors;
+}
+
+// Обработчик папки на другом устройстве: true, если её обход взял на себя другой поток
+using DeviceHandOff = std::function<bool(const fs::path&, dev_t)>;
+
+// Обход поддерева через явный стек: папка, которую не удалось открыть или дочитать,
+// записывается в журнал ошибок, а обход продолжается с остальными. Если задан hand_off,
+// папки на других устройствах передаются ему, иначе обходятся здесь же.
+static bool walk_from(std::vector<fs::path> pending, const ScanMatcher& matcher, dev_t root_device,
+                      const std::function<bool(const fs::directory_entry&)>& on_file,
+                      const std::function<bool(const fs::directory_entry&)>& on_directory,
+                      const DeviceHandOff& hand_off) {
+    while (!pending.empty()) {
+        fs::path dir_path = std::move(pending.back());
+        pending.pop_back();
+
+        std::error_code ec;
+        fs::directory_iterator it(dir_path, ec);
+        for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            const auto& entry = *it;
+            std::error_code entry_ec;
+            if (!matcher.follow_symlinks() && entry.is_symlink(entry_ec)) {
+                continue;
+            }
+            if (entry.is_directory(entry_ec)) {
+                if (matcher.prune_directory(entry.path())) {
+                    continue; // Не спускаемся в исключённое поддерево
+                }
+                if (matcher.one_file_system() || hand_off) {
+                    struct stat st;
+                    if (::stat(entry.path().c_str(), &st) != 0) {
+                        continue;
+                    }
+                    if (st.st_dev != root_device) {
+                        if (matcher.one_file_system() || hand_off(entry.path(), st.st_dev)) {
+                            continue;
+                        }
+                    }
+                }
+                throttle_io(0); // Чтение содержимого папки — отдельная операция
+                if (on_directory && !on_directory(entry)) {
+                    return false;
+                }
+                pending.push_back(entry.path());
+            } else if (entry_ec) {
+                record_scan_error(entry.path(), entry_ec.message()); // Элемент исчез во время обхода
+            } else if (entry.is_regular_file(entry_ec) && matcher.accept_file(entry)) {
+                if (!on_file(entry)) {
+                    return false;
+                }
+            }
+        }
+        if (ec) {
+            record_scan_error(dir_path, ec.message());
         }
     }
+    return true;
+}
 
-    return duplicates;
+// Рекурсивный обход дерева с учётом правил сканирования
+bool walk_directory_tree(const fs::path& directory, const ScanMatcher& matcher,
+                         const std::function<bool(const fs::directory_entry&)>& on_file,
+                         const std::function<bool(const fs::directory_entry&)>& on_directory) {
+    // Устройство корня нужно только для режима "не выходить за файловую систему"
+    dev_t root_device = 0;
+    if (matcher.one_file_system()) {
+        struct stat st;
+        if (::stat(directory.c_str(), &st) == 0) {
+            root_device = st.st_dev;
+        }
+    }
+    return walk_from({directory}, matcher, root_device, on_file, on_directory, nullptr);
 }
 
-// Функция для поиска пустых папок
-std::vector<fs::path> find_empty_directories(const fs::path& directory) {
-    std::vector<fs::path> empty_dirs;
+// Обход дерева, разделённый по устройствам. У каждого устройства своя очередь папок
+// и свой поток; поток создаётся, когда обход впервые встречает точку монтирования
+// этого устройства. Обход заканчивается, когда не остаётся ни очередных, ни
+// обрабатываемых папок.
+bool walk_directory_tree_by_device(const fs::path& directory, const ScanMatcher& matcher,
+                                   const std::function<bool(const fs::directory_entry&)>& on_file) {
+    struct Shard {
+        std::vector<fs::path> queue;
+    };
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::map<dev_t, Shard> shards;
+    std::vector<std::thread> threads;
+    std::size_t outstanding = 0; // Папки в очередях и в обработке
+    bool stopped = false;
+
+    std::function<void(dev_t)> run_shard;
+    // Папка отдаётся потоку её устройства (вызывается под mutex)
+    auto enqueue = [&](const fs::path& dir, dev_t device) {
+        auto [it, created] = shards.try_emplace(device);
+        it->second.queue.push_back(dir);
+        outstanding++;
+        if (created) {
+            threads.emplace_back(run_shard, device);
+        }
+        changed.notify_all();
+    };
+    DeviceHandOff hand_off = [&](const fs::path& dir, dev_t device) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!stopped) {
+            enqueue(dir, device);
+        }
+        return true;
+    };
+    run_shard = [&](dev_t device) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [&]() { return !shards[device].queue.empty() || outstanding == 0; });
+            if (shards[device].queue.empty()) {
+                return; // Обход всех устройств завершён
+            }
+            std::vector<fs::path> pending;
+            pending.swap(shards[device].queue);
+            std::size_t taken = pending.size();
+            bool skip = stopped;
+            lock.unlock();
+            bool completed = skip || walk_from(std::move(pending), matcher, device, on_file, nullptr, hand_off);
+            lock.lock();
+            if (!completed) {
+                stopped = true;
+            }
+            outstanding -= taken;
+            if (outstanding == 0) {
+                changed.notify_all();
+            }
+        }
+    };
+
+    struct stat st;
+    if (::stat(directory.c_str(), &st) != 0) {
+        record_scan_error(directory, std::strerror(errno));
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    enqueue(directory, st.st_dev);
+    changed.wait(lock, [&]() { return outstanding == 0; });
+    lock.unlock();
+    for (auto& thread : threads) {
+        thread.join(); // После завершения обхода новые потоки уже не создаются
+    }
+    return !stopped;
+}
 
-    for (const auto& entry : fs::recursive_directory_iterator(directory)) {
-        if (fs::is_directory(entry) && fs::is_empty(entry)) {
-            empty_dirs.push_back(entry.path());
+// Потоковый поиск файлов с одинаковым содержимым
+void scan_duplicate_files(const fs::path& directory, const DuplicateGroupSink& on_group, const ScanMatcher& matcher) {
+    std::unordered_map<std::uint64_t, std::vector<HashJob>> size_to_jobs;
+    std::mutex jobs_mutex;
+
+    // Рекурсивно обходим все файлы и подпапки, запоминая размер и inode; каждое устройство
+    // обходится своим потоком, группировка по размеру общая для всех устройств.
+    // stat выполняется в потоке устройства, под блокировкой — только вставка в группу.
+    walk_directory_tree_by_device(directory, matcher, [&](const fs::directory_entry& entry) {
+        HashJob job;
+        if (make_hash_job(entry.path(), job)) {
+            std::lock_guard<std::mutex> lock(jobs_mutex);
+            size_to_jobs[job.size].push_back(std::move(job));
+        }
+        return true;
+    });
+
+    // При отборе по типу тип определяется по началу файла до хэширования: файлы
+    // других типов не читаются целиком, а группа, в которой остался один файл, не хэшируется
+    if (matcher.filters_types()) {
+        for (auto& [size, jobs] : size_to_jobs) {
+            if (jobs.size() > 1) {
+                jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [&](const HashJob& job) {
+                    return !matcher.accept_type(classify_file(job.path));
+                }), jobs.end());
+            }
         }
     }
 
+    // Хэшируются только файлы с совпадающими размерами, в порядке их расположения на диске
+    std::vector<HashJob> queue;
+    std::unordered_map<std::uint64_t, std::size_t> remaining; // Сколько файлов каждого размера ещё не хэшировано
+    for (auto& [size, jobs] : size_to_jobs) {
+        if (jobs.size() > 1) {
+            remaining[size] = jobs.size();
+            std::move(jobs.begin(), jobs.end(), std::back_inserter(queue));
+        }
+    }
+    size_to_jobs.clear();
+    order_by_physical_layout(queue);
+
+    // Группы одного размера отдаются, как только хэшированы все файлы этого размера
+    std::unordered_map<std::uint64_t, std::unordered_map<std::uint64_t, std::vector<fs::path>>> hash_to_files;
+    // Тип определяется тем же чтением, что и хэш; у одинаковых файлов он совпадает.
+    // Файлы хэшируются пулами по устройствам, группы собираются по всем устройствам сразу.
+    hash_jobs_by_device(queue, calculate_file_hash64, [&](HashJob& job) {
+        auto& by_hash = hash_to_files[job.size];
+        if (!job.failed && matcher.accept_type(job.type)) {
+            by_hash[job.hash].push_back(std::move(job.path));
+        }
+        if (--remaining[job.size] > 0) {
+            return true;
+        }
+        bool keep_going = true;
+        for (const auto& [hash, files] : by_hash) {
+            if (files.size() > 1 && keep_going) {
+                keep_going = on_group(files);
+            }
+        }
+        hash_to_files.erase(job.size);
+        return keep_going;
+    });
+}
+
+// Рекурсивная функция для поиска файлов с одинаковым содержимым
+std::vector<std::vector<fs::path>> find_duplicate_files_recursive(const fs::path& directory, const ScanMatcher& matcher) {
+    std::vector<std::vector<fs::path>> duplicates;
+    scan_duplicate_files(directory, [&](const std::vector<fs::path>& files) {
+        duplicates.push_back(files);
+        return true;
+    }, matcher);
+    return duplicates;
+}
+
+// Поиск дубликатов с ограниченным расходом памяти
+void find_duplicate_files_external(const fs::path& directory, std::size_t memory_budget,
+                                   const DuplicateGroupSink& on_group,
+                                   const fs::path& spill_parent, const ScanMatcher& matcher) {
+    fs::path spill_dir = make_spill_directory(spill_parent);
+    {
+        // Половина бюджета на каждый из двух проходов сортировки
+        PathStore paths(spill_dir / "paths.bin");
+        SpillSorter by_size(spill_dir, memory_budget / 2);
+
+        // Проход 1: (размер, номер пути) без чтения содержимого
+        walk_directory_tree(directory, matcher, [&](const fs::directory_entry& entry) {
+            std::error_code ec;
+            std::uintmax_t size = entry.file_size(ec);
+            if (ec) {
+                record_scan_error(entry.path(), ec.message()); // Файл исчез между readdir и stat
+                return true;
+            }
+            by_size.add({size, 0, paths.add(entry.path())});
+            return true;
+        });
+        by_size.finish();
+
+        // Проход 2: хэшируются только файлы, размер которых встречается больше одного раза
+        fs::path hashed_dir = spill_dir / "hashed";
+        fs::create_directory(hashed_dir);
+        SpillSorter by_hash(hashed_dir, memory_budget / 2);
+
+        SpillRecord record;
+        SpillRecord first{};
+        std::size_t same_size = 0;
+        auto hash_record = [&](const SpillRecord& r) {
+            fs::path path = paths.get(r.path_id);
+            // Тип по началу файла проверяется до чтения всего содержимого
+            if (matcher.filters_types() && !matcher.accept_type(classify_file(path))) {
+                return;
+            }
+            try {
+                FileType type;
+                std::uint64_t hash = calculate_file_hash64(path, &type);
+                if (matcher.accept_type(type)) {
+                    by_hash.add({r.size, hash, r.path_id});
+                }
+            } catch (const std::runtime_error& error) {
+                record_scan_error(path, error); // Файл исчез или недоступен — пропускаем
+            }
+        };
+        while (by_size.next(record)) {
+            if (same_size > 0 && record.size == first.size) {
+                if (same_size == 1) {
+                    hash_record(first);
+                }
+                hash_record(record);
+                ++same_size;
+            } else {
+                first = record;
+                same_size = 1;
+            }
+        }
+        by_hash.finish();
+
+        // Проход 3: соседние записи с одинаковыми (размер, хэш) образуют группу дубликатов
+        std::vector<fs::path> group;
+        SpillRecord previous{};
+        bool has_previous = false;
+        bool keep_going = true;
+        while (keep_going && by_hash.next(record)) {
+            if (has_previous && (record.size != previous.size || record.hash != previous.hash)) {
+                if (group.size() > 1) {
+                    keep_going = on_group(group);
+                }
+                group.clear();
+            }
+            group.push_back(paths.get(record.path_id));
+            previous = record;
+            has_previous = true;
+        }
+        if (keep_going && group.size() > 1) {
+            on_group(group);
+        }
+    }
+    std::error_code ec;
+    fs::remove_all(spill_dir, ec);
+}
+
+// Потоковый поиск пустых папок
+void scan_empty_directories(const fs::path& directory, const EmptyDirectorySink& on_directory, const ScanMatcher& matcher) {
+    auto skip_file = [](const fs::directory_entry&) { return true; };
+    walk_directory_tree(directory, matcher, skip_file, [&](const fs::directory_entry& entry) {
+        std::error_code ec;
+        bool empty = fs::is_empty(entry, ec);
+        return ec || !empty || on_directory(entry.path());
+    });
+}
+
+// Функция для поиска пустых папок
+std::vector<fs::path> find_empty_directories(const fs::path& directory, const ScanMatcher& matcher) {
+    std::vector<fs::path> empty_dirs;
+    scan_empty_directories(directory, [&](const fs::path& dir) {
+        empty_dirs.push_back(dir);
+        return true;
+    }, matcher);
+
     return empty_dirs;
 }
 // Функция для преобразования file_time_type в system_clock::time_point
@@ -122,34 +466,47 @@ std::vector<FileInfo> find_unused_files(const fs::path& directory, int days_thre
 
     return unused_files;
 }
-// Рекурсивная функция для поиска файлов, которые давно не использовались
-std::vector<FileInfo> find_unused_files_recursive(const fs::path& directory, int days_threshold) {
-    std::vector<FileInfo> unused_files;
+// Потоковый поиск файлов, которые давно не использовались
+void scan_unused_files(const fs::path& directory, int days_threshold, const UnusedFileSink& on_file, const ScanMatcher& matcher) {
     auto now = std::chrono::system_clock::now();
 
     // Рекурсивно обходим все файлы и подпапки
-    for (const auto& entry : fs::recursive_directory_iterator(directory)) {
-        if (fs::is_regular_file(entry)) {
-            FileInfo file_info;
-            file_info.name = entry.path().filename().string();
-            file_info.path = entry.path().string();
-            file_info.size = fs::file_size(entry);
-
-            // Получаем время последнего изменения файла
-            auto last_used_time = fs::last_write_time(entry);
-            auto last_used_system_time = std::chrono::system_clock::now() - (fs::file_time_type::clock::now() - last_used_time);
-            auto last_used_duration = std::chrono::duration_cast<std::chrono::hours>(now - last_used_system_time).count() / 24;
+    walk_directory_tree(directory, matcher, [&](const fs::directory_entry& entry) {
+        FileInfo file_info;
+        file_info.name = entry.path().filename().string();
+        file_info.path = entry.path().string();
+        std::error_code ec;
+        file_info.size = entry.file_size(ec);
+
+        // Получаем время последнего изменения файла
+        auto last_used_time = ec ? fs::file_time_type() : entry.last_write_time(ec);
+        if (ec) {
+            record_scan_error(entry.path(), ec.message()); // Файл удалён во время обхода
+            return true;
+        }
+        auto last_used_system_time = std::chrono::system_clock::now() - (fs::file_time_type::clock::now() - last_used_time);
+        auto last_used_duration = std::chrono::duration_cast<std::chrono::hours>(now - last_used_system_time).count() / 24;
 
-            // Сохраняем время последнего использования
-            file_info.last_used = std::chrono::system_clock::to_time_t(last_used_system_time);
+        // Сохраняем время последнего использования
+        file_info.last_used = std::chrono::system_clock::to_time_t(last_used_system_time);
 
-            // Проверяем, превышает ли время последнего использования порог
-            if (last_used_duration > days_threshold) {
-                unused_files.push_back(file_info);
-            }
+        // Проверяем, превышает ли время последнего использования порог;
+        // тип определяется только для старых файлов и только если задан отбор по типу
+        if (last_used_duration <= days_threshold ||
+            (matcher.filters_types() && !matcher.accept_type(classify_file(entry.path())))) {
+            return true;
         }
-    }
+        return on_file(file_info);
+    });
+}
 
+// Рекурсивная функция для поиска файлов, которые давно не использовались
+std::vector<FileInfo> find_unused_files_recursive(const fs::path& directory, int days_threshold, const ScanMatcher& matcher) {
+    std::vector<FileInfo> unused_files;
+    scan_unused_files(directory, days_threshold, [&](const FileInfo& file_info) {
+        unused_files.push_back(file_info);
+        return true;
+    }, matcher);
     return unused_files;
 }
 
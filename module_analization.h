@@ -4,6 +4,9 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <functional>
+#include <cstdint>
+#include "module_scan_rules.h"
 
 namespace fs = std::filesystem;
 
@@ -15,13 +18,77 @@ struct FileInfo {
     std::time_t last_used;
 };
 
+// Сведения о группе дубликатов, известные из снимка без обращения к диску
+struct DuplicateGroupInfo {
+    std::uint64_t file_size = 0;  // Размер одного файла
+    std::time_t oldest_mtime = 0; // Время изменения самого старого файла группы
+};
+
+// Функция для вычисления 64-битного хэша содержимого файла (чтение блоками фиксированного размера).
+// Если передан type, по первому прочитанному блоку заодно определяется тип файла.
+std::uint64_t calculate_file_hash64(const fs::path& file_path, FileType* type = nullptr);
+
+// Элемент, пропущенный при анализе: недоступен, исчез во время обхода или не прочитался
+struct ScanError {
+    std::string path;
+    std::string reason;
+};
+
+// Запись ошибки в журнал анализа (потокобезопасно). Обход и хэширование не прерываются
+// из-за отдельных элементов: они пропускаются и попадают в журнал.
+void record_scan_error(const fs::path& path, const std::string& reason);
+
+// Описание ошибки чтения файла (для std::system_error — текст errno)
+void record_scan_error(const fs::path& path, const std::exception& error);
+
+// Накопленные ошибки; журнал очищается
+std::vector<ScanError> take_scan_errors();
+
+// Обработчики результатов анализа: каждый результат передаётся сразу, как только найден.
+// Если обработчик вернёт false, анализ прекращается.
+using UnusedFileSink = std::function<bool(const FileInfo&)>;
+using DuplicateGroupSink = std::function<bool(const std::vector<fs::path>&)>;
+using EmptyDirectorySink = std::function<bool(const fs::path&)>;
+
+// Рекурсивный обход дерева с учётом правил: исключённые папки отсекаются до спуска в них,
+// для каждого принятого файла вызывается on_file, для каждой папки — on_directory.
+// Возвращает false, если обход остановлен обработчиком.
+bool walk_directory_tree(const fs::path& directory, const ScanMatcher& matcher,
+                         const std::function<bool(const fs::directory_entry&)>& on_file,
+                         const std::function<bool(const fs::directory_entry&)>& on_directory = nullptr);
+
+// Обход дерева, разделённый по устройствам (st_dev): каждая файловая система обходится
+// своим потоком, поэтому медленный диск не задерживает обход остальных. on_file вызывается
+// из потоков разных устройств одновременно: общие данные обработчик защищает сам, чтобы
+// медленная работа с файлом (например, stat) одного устройства не ждала другие.
+bool walk_directory_tree_by_device(const fs::path& directory, const ScanMatcher& matcher,
+                                   const std::function<bool(const fs::directory_entry&)>& on_file);
+
+// Потоковые версии анализа
+void scan_unused_files(const fs::path& directory, int days_threshold, const UnusedFileSink& on_file,
+                       const ScanMatcher& matcher = ScanMatcher());
+void scan_duplicate_files(const fs::path& directory, const DuplicateGroupSink& on_group,
+                          const ScanMatcher& matcher = ScanMatcher());
+void scan_empty_directories(const fs::path& directory, const EmptyDirectorySink& on_directory,
+                            const ScanMatcher& matcher = ScanMatcher());
+
 // Рекурсивная версия функции для поиска файлов, которые давно не использовались
-std::vector<FileInfo> find_unused_files_recursive(const fs::path& directory, int days_threshold = 30);
+std::vector<FileInfo> find_unused_files_recursive(const fs::path& directory, int days_threshold = 30,
+                                                  const ScanMatcher& matcher = ScanMatcher());
 
 // Рекурсивная версия функции для поиска файлов с одинаковым содержимым
-std::vector<std::vector<fs::path>> find_duplicate_files_recursive(const fs::path& directory);
+std::vector<std::vector<fs::path>> find_duplicate_files_recursive(const fs::path& directory,
+                                                                  const ScanMatcher& matcher = ScanMatcher());
+
+// Поиск дубликатов с ограниченным расходом памяти: записи (размер, хэш, номер пути)
+// сбрасываются на диск отсортированными сериями и группируются внешним слиянием.
+// Каждая найденная группа передаётся в on_group и не накапливается в памяти.
+void find_duplicate_files_external(const fs::path& directory, std::size_t memory_budget,
+                                   const DuplicateGroupSink& on_group,
+                                   const fs::path& spill_parent = fs::temp_directory_path(),
+                                   const ScanMatcher& matcher = ScanMatcher());
 
 // Функция для поиска пустых папок
-std::vector<fs::path> find_empty_directories(const fs::path& directory);
+std::vector<fs::path> find_empty_directories(const fs::path& directory, const ScanMatcher& matcher = ScanMatcher());
 
 #endif // MODULE_ANALIZATION_H
\ No newline at end of file
@@ -0,0 +1,605 @@
+#include "module_archive.h"
+#include "module_io_policy.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+// Сигнатуры начала архива и конца индекса. Во второй версии в индексе у каждой
+// записи есть CRC-32 исходных данных; архивы первой версии читаются без проверки.
+static const char kPackMagic[8] = {'A', 'N', 'P', 'A', 'C', 'K', '0', '2'};
+static const char kPackMagicV1[8] = {'A', 'N', 'P', 'A', 'C', 'K', '0', '1'};
+static const char kIndexMagic[8] = {'A', 'N', 'I', 'D', 'X', '0', '0', '1'};
+
+// Размер блока сжатия и буфера записи
+static const std::size_t kBlockSize = 64 * 1024;
+static const std::size_t kWriteBufferSize = 4 * 1024 * 1024;
+
+// ---- Контрольная сумма ----
+
+// CRC-32 (полином 0xEDB88320, как в zlib), таблица строится при первом вызове
+static std::uint32_t update_crc32(std::uint32_t crc, const void* data, std::size_t size) {
+    static const auto table = []() {
+        std::vector<std::uint32_t> t(256);
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// ---- Встроенный компрессор ----
+// Последовательность: байт-токен (старшие 4 бита — длина литералов, младшие —
+// длина совпадения минус 4), продолжения длин по 255, литералы, смещение (2 байта).
+// Последняя последовательность содержит только литералы.
+
+static const int kHashBits = 14;
+static const std::size_t kMinMatch = 4;
+
+static std::uint32_t read32(const unsigned char* p) {
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static std::uint32_t hash32(std::uint32_t value) {
+    return (value * 2654435761U) >> (32 - kHashBits);
+}
+
+static void write_length(std::vector<unsigned char>& out, std::size_t length) {
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(static_cast<unsigned char>(length));
+}
+
+static void emit_sequence(std::vector<unsigned char>& out, const unsigned char* literals, std::size_t literal_length,
+                          std::size_t offset, std::size_t match_length) {
+    std::size_t match_code = match_length >= kMinMatch ? match_length - kMinMatch : 0;
+    unsigned char token = static_cast<unsigned char>((std::min<std::size_t>(literal_length, 15) << 4) |
+                                                     std::min<std::size_t>(match_code, 15));
+    out.push_back(token);
+    if (literal_length >= 15) {
+        write_length(out, literal_length - 15);
+    }
+    out.insert(out.end(), literals, literals + literal_length);
+    if (match_length == 0) {
+        return; // Последняя последовательность
+    }
+    out.push_back(static_cast<unsigned char>(offset & 0xFF));
+    out.push_back(static_cast<unsigned char>(offset >> 8));
+    if (match_code >= 15) {
+        write_length(out, match_code - 15);
+    }
+}
+
+// Сжатие блока
+static void compress_block(const unsigned char* src, std::size_t size, std::vector<unsigned char>& out) {
+    out.clear();
+    std::vector<std::int32_t> table(1 << kHashBits, -1);
+    std::size_t ip = 0;
+    std::size_t anchor = 0;
+
+    while (ip + kMinMatch <= size) {
+        std::uint32_t sequence = read32(src + ip);
+        std::uint32_t h = hash32(sequence);
+        std::int32_t ref = table[h];
+        table[h] = static_cast<std::int32_t>(ip);
+
+        if (ref >= 0 && ip - ref <= 0xFFFF && read32(src + ref) == sequence) {
+            std::size_t length = kMinMatch;
+            while (ip + length < size && src[ref + length] == src[ip + length]) {
+                ++length;
+            }
+            emit_sequence(out, src + anchor, ip - anchor, ip - ref, length);
+            ip += length;
+            anchor = ip;
+        } else {
+            ++ip;
+        }
+    }
+    emit_sequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+// Распаковка блока; false, если данные повреждены
+static bool decompress_block(const unsigned char* src, std::size_t size, unsigned char* dst, std::size_t raw_size) {
+    std::size_t ip = 0;
+    std::size_t op = 0;
+    auto read_length = [&](std::size_t& length) {
+        unsigned char extra;
+        do {
+            if (ip >= size) return false;
+            extra = src[ip++];
+            length += extra;
+        } while (extra == 255);
+        return true;
+    };
+
+    while (ip < size) {
+        unsigned char token = src[ip++];
+        std::size_t literal_length = token >> 4;
+        if (literal_length == 15 && !read_length(literal_length)) return false;
+        if (ip + literal_length > size || op + literal_length > raw_size) return false;
+        std::memcpy(dst + op, src + ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+        if (ip == size) {
+            break;
+        }
+
+        if (ip + 2 > size) return false;
+        std::size_t offset = src[ip] | (static_cast<std::size_t>(src[ip + 1]) << 8);
+        ip += 2;
+        std::size_t match_length = token & 0x0F;
+        if (match_length == 15 && !read_length(match_length)) return false;
+        match_length += kMinMatch;
+        if (offset == 0 || offset > op || op + match_length > raw_size) return false;
+        // Совпадение может перекрываться с копируемым участком, поэтому побайтно
+        for (std::size_t i = 0; i < match_length; ++i, ++op) {
+            dst[op] = dst[op - offset];
+        }
+    }
+    return op == raw_size;
+}
+
+// ---- Запись архива ----
+
+// Буферизованная последовательная запись большими блоками
+class PackWriter {
+public:
+    explicit PackWriter(int fd) : fd_(fd) {
+        buffer_.reserve(kWriteBufferSize);
+    }
+
+    void write(const void* data, std::size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        if (buffer_.size() + size > kWriteBufferSize) {
+            flush();
+        }
+        if (size >= kWriteBufferSize) {
+            write_all(bytes, size);
+        } else {
+            buffer_.insert(buffer_.end(), bytes, bytes + size);
+        }
+        position_ += size;
+    }
+
+    template <typename T>
+    void write_value(const T& value) {
+        write(&value, sizeof(value));
+    }
+
+    void write_string(const std::string& text) {
+        write_value(static_cast<std::uint32_t>(text.size()));
+        write(text.data(), text.size());
+    }
+
+    void flush() {
+        if (!buffer_.empty()) {
+            write_all(buffer_.data(), buffer_.size());
+            buffer_.clear();
+        }
+    }
+
+    // Откат к смещению (данные файла, который не удалось прочитать, отбрасываются)
+    void rewind(std::uint64_t offset) {
+        flush();
+        if (::ftruncate(fd_, static_cast<off_t>(offset)) != 0 || ::lseek(fd_, static_cast<off_t>(offset), SEEK_SET) < 0) {
+            throw std::runtime_error("Не удалось откатить запись архива");
+        }
+        position_ = offset;
+    }
+
+    std::uint64_t position() const { return position_; }
+
+private:
+    void write_all(const char* data, std::size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd_, data, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::strerror(errno));
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+    }
+
+    int fd_;
+    std::vector<char> buffer_;
+    std::uint64_t position_ = 0;
+};
+
+// Упаковка одного файла; возвращает размер записанных данных, в crc — CRC-32 исходных данных
+static std::uint64_t pack_file(PackWriter& writer, const fs::path& file_path, bool compress, std::uint32_t& crc) {
+    crc = 0;
+    std::uint64_t start = writer.position();
+    std::vector<unsigned char> block;
+    std::vector<unsigned char> packed;
+    block.reserve(kBlockSize);
+
+    auto flush_block = [&]() {
+        compress_block(block.data(), block.size(), packed);
+        std::uint32_t raw_size = static_cast<std::uint32_t>(block.size());
+        bool stored = packed.size() >= block.size(); // Несжимаемые данные хранятся как есть
+        std::uint32_t stored_size = stored ? raw_size : static_cast<std::uint32_t>(packed.size());
+        writer.write_value(raw_size);
+        writer.write_value(stored_size);
+        writer.write(stored ? block.data() : packed.data(), stored_size);
+        block.clear();
+    };
+
+    read_file_blocks(file_path, [&](const char* data, std::size_t size) {
+        crc = update_crc32(crc, data, size);
+        if (!compress) {
+            writer.write(data, size);
+            return;
+        }
+        while (size > 0) {
+            std::size_t take = std::min(size, kBlockSize - block.size());
+            block.insert(block.end(), data, data + take);
+            data += take;
+            size -= take;
+            if (block.size() == kBlockSize) {
+                flush_block();
+            }
+        }
+    });
+    if (compress && !block.empty()) {
+        flush_block();
+    }
+    return writer.position() - start;
+}
+
+static int read_index(int fd, std::vector<PackEntry>& entries);
+static int extract_entry(int pack_fd, const PackEntry& entry, int out_fd);
+
+// Проверка записанного архива перед удалением исходных файлов: индекс читается с диска
+// и сверяется с записанным, данные каждой записи распаковываются и сверяются с CRC
+static int verify_pack(int fd, const std::vector<PackEntry>& written) {
+    // Страницы уже сброшены на диск; без кэша проверка читает то, что действительно записано
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    std::vector<PackEntry> entries;
+    int error = read_index(fd, entries);
+    if (error != 0) {
+        return error;
+    }
+    if (entries.size() != written.size()) {
+        return EBADMSG;
+    }
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        const PackEntry& a = entries[i];
+        const PackEntry& b = written[i];
+        if (a.path != b.path || a.offset != b.offset || a.stored_size != b.stored_size ||
+            a.original_size != b.original_size || a.crc32 != b.crc32 || !a.has_crc) {
+            return EBADMSG;
+        }
+        error = extract_entry(fd, a, -1);
+        if (error != 0) {
+            return error;
+        }
+    }
+    return 0;
+}
+
+// Упаковка файлов в архив
+int tier_out(const std::vector<fs::path>& files, const fs::path& base, const fs::path& pack_path,
+             bool compress, bool remove_originals, TierOutResult* result,
+             const std::function<void(std::size_t, std::size_t)>& progress) {
+    // Архив может содержать закрытые файлы, а после удаления исходных он — единственная
+    // копия, поэтому доступен только владельцу
+    int fd = ::open(pack_path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return errno;
+    }
+
+    TierOutResult summary;
+    std::vector<PackEntry> index;
+    std::vector<std::pair<fs::path, struct stat>> packed_files; // Файл и его состояние на момент упаковки
+    int error = 0;
+    try {
+        PackWriter writer(fd);
+        writer.write(kPackMagic, sizeof(kPackMagic));
+
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            const fs::path& file_path = files[i];
+            struct stat st;
+            if (::stat(file_path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+                summary.failed++;
+                continue;
+            }
+            PackEntry entry;
+            entry.path = file_path.lexically_relative(base).string();
+            if (entry.path.empty() || entry.path.compare(0, 2, "..") == 0) {
+                entry.path = file_path.string(); // Файл вне базовой папки — сохраняется полный путь
+            }
+            entry.offset = writer.position();
+            entry.original_size = static_cast<std::uint64_t>(st.st_size);
+            entry.mode = st.st_mode & 07777;
+            entry.mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+            entry.compressed = compress;
+            try {
+                entry.stored_size = pack_file(writer, file_path, compress, entry.crc32);
+            } catch (const std::runtime_error&) {
+                writer.rewind(entry.offset);
+                summary.failed++;
+                continue;
+            }
+            summary.packed++;
+            summary.bytes_in += entry.original_size;
+            summary.bytes_out += entry.stored_size;
+            index.push_back(std::move(entry));
+            packed_files.emplace_back(file_path, st);
+            if (progress) {
+                progress(i + 1, files.size());
+            }
+        }
+
+        // Индекс в конце архива, за ним — его смещение и сигнатура
+        std::uint64_t index_offset = writer.position();
+        writer.write_value(static_cast<std::uint64_t>(index.size()));
+        for (const auto& entry : index) {
+            writer.write_string(entry.path);
+            writer.write_value(entry.offset);
+            writer.write_value(entry.stored_size);
+            writer.write_value(entry.original_size);
+            writer.write_value(entry.mode);
+            writer.write_value(entry.mtime_ns);
+            writer.write_value(static_cast<std::uint8_t>(entry.compressed));
+            writer.write_value(entry.crc32);
+        }
+        writer.write_value(index_offset);
+        writer.write(kIndexMagic, sizeof(kIndexMagic));
+        writer.flush();
+        if (::fsync(fd) != 0) {
+            error = errno;
+        }
+    } catch (const std::runtime_error&) {
+        error = EIO;
+    }
+    if (error == 0 && remove_originals) {
+        error = verify_pack(fd, index);
+    }
+    if (::close(fd) != 0 && error == 0) {
+        error = errno;
+    }
+    if (error != 0) {
+        ::unlink(pack_path.c_str());
+        return error;
+    }
+
+    if (remove_originals) {
+        // Запись об архиве в папке тоже должна дойти до диска, иначе после сбоя
+        // питания можно остаться и без архива, и без исходных файлов
+        fs::path pack_dir = pack_path.has_parent_path() ? pack_path.parent_path() : fs::path(".");
+        int dir_fd = ::open(pack_dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd < 0 || ::fsync(dir_fd) != 0) {
+            error = errno;
+        }
+        if (dir_fd >= 0) {
+            ::close(dir_fd);
+        }
+        if (error != 0) {
+            if (result) {
+                *result = summary;
+            }
+            return error; // Архив цел, исходные файлы не тронуты
+        }
+
+        // Файл, изменённый после упаковки, удалять нельзя: в архиве его старое содержимое
+        for (const auto& [file_path, packed] : packed_files) {
+            struct stat st;
+            if (::lstat(file_path.c_str(), &st) != 0 || st.st_dev != packed.st_dev || st.st_ino != packed.st_ino ||
+                st.st_size != packed.st_size || st.st_mtim.tv_sec != packed.st_mtim.tv_sec ||
+                st.st_mtim.tv_nsec != packed.st_mtim.tv_nsec) {
+                summary.kept++;
+                continue;
+            }
+            ::unlink(file_path.c_str());
+        }
+    }
+    if (result) {
+        *result = summary;
+    }
+    return 0;
+}
+
+// ---- Чтение архива ----
+
+// Чтение ровно size байт по смещению
+static bool pread_all(int fd, void* data, std::size_t size, std::uint64_t offset) {
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t count = ::pread(fd, bytes, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        bytes += count;
+        size -= static_cast<std::size_t>(count);
+        offset += static_cast<std::uint64_t>(count);
+    }
+    return true;
+}
+
+// Чтение индекса из открытого архива
+static int read_index(int fd, std::vector<PackEntry>& entries) {
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        return errno;
+    }
+    std::uint64_t file_size = static_cast<std::uint64_t>(st.st_size);
+    char magic[8];
+    std::uint64_t index_offset = 0;
+    const std::uint64_t trailer = sizeof(index_offset) + sizeof(kIndexMagic);
+    bool has_crc = false;
+    if (file_size < sizeof(kPackMagic) + trailer || !pread_all(fd, magic, sizeof(magic), 0) ||
+        (!(has_crc = std::memcmp(magic, kPackMagic, sizeof(magic)) == 0) &&
+         std::memcmp(magic, kPackMagicV1, sizeof(magic)) != 0) ||
+        !pread_all(fd, &index_offset, sizeof(index_offset), file_size - trailer) ||
+        !pread_all(fd, magic, sizeof(magic), file_size - sizeof(kIndexMagic)) ||
+        std::memcmp(magic, kIndexMagic, sizeof(magic)) != 0 || index_offset > file_size - trailer) {
+        return EBADMSG;
+    }
+
+    // Индекс целиком читается одним запросом
+    std::vector<char> data(file_size - trailer - index_offset);
+    if (!pread_all(fd, data.data(), data.size(), index_offset)) {
+        return EIO;
+    }
+    std::size_t pos = 0;
+    auto take = [&](void* out, std::size_t size) {
+        if (pos + size > data.size()) return false;
+        std::memcpy(out, data.data() + pos, size);
+        pos += size;
+        return true;
+    };
+
+    std::uint64_t count = 0;
+    if (!take(&count, sizeof(count))) {
+        return EBADMSG;
+    }
+    entries.clear();
+    for (std::uint64_t i = 0; i < count; ++i) {
+        PackEntry entry;
+        std::uint32_t length = 0;
+        std::uint8_t compressed = 0;
+        if (!take(&length, sizeof(length)) || pos + length > data.size()) {
+            return EBADMSG;
+        }
+        entry.path.assign(data.data() + pos, length);
+        pos += length;
+        if (!take(&entry.offset, sizeof(entry.offset)) || !take(&entry.stored_size, sizeof(entry.stored_size)) ||
+            !take(&entry.original_size, sizeof(entry.original_size)) || !take(&entry.mode, sizeof(entry.mode)) ||
+            !take(&entry.mtime_ns, sizeof(entry.mtime_ns)) || !take(&compressed, sizeof(compressed)) ||
+            (has_crc && !take(&entry.crc32, sizeof(entry.crc32)))) {
+            return EBADMSG;
+        }
+        entry.compressed = compressed != 0;
+        entry.has_crc = has_crc;
+        entries.push_back(std::move(entry));
+    }
+    return 0;
+}
+
+// Чтение индекса архива
+int list_pack(const fs::path& pack_path, std::vector<PackEntry>& entries) {
+    int fd = ::open(pack_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno;
+    }
+    int error = read_index(fd, entries);
+    ::close(fd);
+    return error;
+}
+
+// Распаковка данных записи в открытый файл назначения (out_fd < 0 — только проверка).
+// Если в архиве есть CRC, распакованные данные сверяются с ним.
+static int extract_entry(int pack_fd, const PackEntry& entry, int out_fd) {
+    std::uint32_t crc = 0;
+    std::uint64_t extracted = 0;
+    std::vector<unsigned char> stored(kWriteBufferSize);
+    std::vector<unsigned char> raw(kBlockSize);
+    std::uint64_t offset = entry.offset;
+    const std::uint64_t end = entry.offset + entry.stored_size;
+
+    while (offset < end) {
+        const unsigned char* data = nullptr;
+        std::size_t size = 0;
+        if (entry.compressed) {
+            std::uint32_t header[2];
+            if (!pread_all(pack_fd, header, sizeof(header), offset) || header[0] > kBlockSize || header[1] > kBlockSize) {
+                return EBADMSG;
+            }
+            offset += sizeof(header);
+            if (!pread_all(pack_fd, stored.data(), header[1], offset)) {
+                return EIO;
+            }
+            offset += header[1];
+            if (header[1] == header[0]) {
+                data = stored.data();
+            } else if (decompress_block(stored.data(), header[1], raw.data(), header[0])) {
+                data = raw.data();
+            } else {
+                return EBADMSG;
+            }
+            size = header[0];
+        } else {
+            size = static_cast<std::size_t>(std::min<std::uint64_t>(stored.size(), end - offset));
+            if (!pread_all(pack_fd, stored.data(), size, offset)) {
+                return EIO;
+            }
+            offset += size;
+            data = stored.data();
+        }
+        crc = update_crc32(crc, data, size);
+        extracted += size;
+        while (out_fd >= 0 && size > 0) {
+            ssize_t written = ::write(out_fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return errno;
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+    }
+    if (extracted != entry.original_size || (entry.has_crc && crc != entry.crc32)) {
+        return EBADMSG;
+    }
+    return 0;
+}
+
+// Восстановление одного файла из архива
+int restore_from_pack(const fs::path& pack_path, const std::string& entry_path, const fs::path& destination) {
+    int pack_fd = ::open(pack_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (pack_fd < 0) {
+        return errno;
+    }
+    std::vector<PackEntry> entries;
+    int error = read_index(pack_fd, entries);
+    auto it = std::find_if(entries.begin(), entries.end(), [&](const PackEntry& e) { return e.path == entry_path; });
+    if (error == 0 && it == entries.end()) {
+        error = ENOENT;
+    }
+    if (error != 0) {
+        ::close(pack_fd);
+        return error;
+    }
+
+    int out_fd = ::open(destination.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, it->mode);
+    if (out_fd < 0) {
+        error = errno;
+        ::close(pack_fd);
+        return error;
+    }
+    error = extract_entry(pack_fd, *it, out_fd);
+    if (error == 0) {
+        struct timespec times[2];
+        times[0].tv_sec = 0;
+        times[0].tv_nsec = UTIME_OMIT;
+        times[1].tv_sec = static_cast<time_t>(it->mtime_ns / 1000000000LL);
+        times[1].tv_nsec = static_cast<long>(it->mtime_ns % 1000000000LL);
+        ::futimens(out_fd, times);
+    }
+    ::close(out_fd);
+    ::close(pack_fd);
+    if (error != 0) {
+        ::unlink(destination.c_str());
+    }
+    return error;
+}
@@ -0,0 +1,54 @@
+#ifndef MODULE_ARCHIVE_H
+#define MODULE_ARCHIVE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <functional>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Запись индекса архива
+struct PackEntry {
+    std::string path;            // Путь относительно базовой папки
+    std::uint64_t offset;        // Начало данных в архиве
+    std::uint64_t stored_size;   // Размер данных в архиве
+    std::uint64_t original_size; // Исходный размер файла
+    std::uint32_t mode;
+    std::int64_t mtime_ns;
+    bool compressed;
+    std::uint32_t crc32 = 0; // CRC-32 исходных данных
+    bool has_crc = false;    // В архивах первой версии CRC нет
+};
+
+// Итог упаковки
+struct TierOutResult {
+    std::size_t packed = 0;
+    std::size_t failed = 0;
+    std::size_t kept = 0;      // Изменились после упаковки, поэтому не удалены
+    std::uint64_t bytes_in = 0;
+    std::uint64_t bytes_out = 0;
+};
+
+// Упаковка файлов в один архив с индексом: данные пишутся большими
+// последовательными блоками, при compress — каждый блок 64 КБ сжимается
+// встроенным быстрым компрессором (формат последовательностей как в LZ4).
+// Архив создаётся с правами 0600, у каждой записи — CRC-32 исходных данных.
+// Исходные файлы удаляются только после того, как архив и запись о нём в папке сброшены
+// на диск, архив прочитан заново и все записи сошлись с CRC, и только если файл
+// не изменился с момента упаковки (inode, размер, время).
+// Возвращает 0 или код ошибки (errno); EEXIST, если архив уже существует.
+int tier_out(const std::vector<fs::path>& files, const fs::path& base, const fs::path& pack_path,
+             bool compress, bool remove_originals, TierOutResult* result = nullptr,
+             const std::function<void(std::size_t done, std::size_t total)>& progress = nullptr);
+
+// Чтение индекса архива без распаковки данных
+int list_pack(const fs::path& pack_path, std::vector<PackEntry>& entries);
+
+// Восстановление одного файла из архива (EEXIST, если файл назначения уже есть;
+// EBADMSG, если данные не сошлись с CRC — частично восстановленный файл удаляется)
+int restore_from_pack(const fs::path& pack_path, const std::string& entry_path, const fs::path& destination);
+
+#endif // MODULE_ARCHIVE_H
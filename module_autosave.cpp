@@ -0,0 +1,261 @@
+#include "module_autosave.h"
+#include "module_redactor.h"
+#include <fstream>
+#include <iterator>
+#include <cerrno>
+#include <cstdlib>
+#include <csignal>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+// Кодирование строк буфера в UTF-8
+std::string encode_buffer(const std::vector<std::wstring>& lines) {
+    std::string content;
+    for (const auto& line : lines) {
+        for (wchar_t wc : line) {
+            if (wc <= 0x7F) {
+                content += static_cast<char>(wc);
+            } else if (wc <= 0x7FF) {
+                content += static_cast<char>(0xC0 | (wc >> 6));
+                content += static_cast<char>(0x80 | (wc & 0x3F));
+            } else if (wc <= 0xFFFF) {
+                content += static_cast<char>(0xE0 | (wc >> 12));
+                content += static_cast<char>(0x80 | ((wc >> 6) & 0x3F));
+                content += static_cast<char>(0x80 | (wc & 0x3F));
+            } else {
+                // Символы вне базовой плоскости (эмодзи и т.п.) — четыре байта
+                content += static_cast<char>(0xF0 | (wc >> 18));
+                content += static_cast<char>(0x80 | ((wc >> 12) & 0x3F));
+                content += static_cast<char>(0x80 | ((wc >> 6) & 0x3F));
+                content += static_cast<char>(0x80 | (wc & 0x3F));
+            }
+        }
+        content += "\n";
+    }
+    return content;
+}
+
+// Путь к файлу восстановления
+fs::path swap_path_for(const fs::path& file_path) {
+    return file_path.parent_path() / ("." + file_path.filename().string() + ".swp");
+}
+
+// Декодирование UTF-8 в строки буфера (обратное encode_buffer)
+std::vector<std::wstring> decode_buffer(const std::string& content) {
+    std::vector<std::wstring> lines(1);
+    for (std::size_t i = 0; i < content.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(content[i]);
+        wchar_t wc = c;
+        if (c >= 0xF0 && i + 3 < content.size()) {
+            wc = ((c & 0x07) << 18) | ((content[i + 1] & 0x3F) << 12) | ((content[i + 2] & 0x3F) << 6) |
+                 (content[i + 3] & 0x3F);
+            i += 3;
+        } else if (c >= 0xE0 && i + 2 < content.size()) {
+            wc = ((c & 0x0F) << 12) | ((content[i + 1] & 0x3F) << 6) | (content[i + 2] & 0x3F);
+            i += 2;
+        } else if (c >= 0xC0 && i + 1 < content.size()) {
+            wc = ((c & 0x1F) << 6) | (content[i + 1] & 0x3F);
+            i += 1;
+        }
+        if (wc == L'\n') {
+            lines.push_back(L"");
+        } else {
+            lines.back() += wc;
+        }
+    }
+    // Каждая строка записывается с переводом строки, последняя пустая — лишняя
+    if (lines.size() > 1 && lines.back().empty()) {
+        lines.pop_back();
+    }
+    return lines;
+}
+
+// Заголовок файла восстановления: метка и номер процесса редактора, который его пишет
+static const std::string kSwapMagic = "ANSWAP01 ";
+
+static std::string swap_header() {
+    return kSwapMagic + std::to_string(::getpid()) + "\n";
+}
+
+// Запись файла восстановления. В отличие от write_file_atomic ссылки не разыменовываются:
+// временный файл (права 0600 — копия не должна быть доступнее самого файла) переименовывается
+// в сам путь файла восстановления, так что подложенная ссылка заменяется, а не её цель.
+static int write_swap_file(const fs::path& swap_path, const std::string& content) {
+    fs::path tmp_path;
+    int fd = -1;
+    int error = redactor::create_temp_file(swap_path, tmp_path, fd);
+    if (error != 0) {
+        return error;
+    }
+    const char* data = content.data();
+    std::size_t left = content.size();
+    while (left > 0 && error == 0) {
+        ssize_t written = ::write(fd, data, left);
+        if (written < 0) {
+            if (errno != EINTR) error = errno;
+            continue;
+        }
+        data += written;
+        left -= static_cast<std::size_t>(written);
+    }
+    if (error == 0 && ::fsync(fd) != 0) {
+        error = errno;
+    }
+    if (::close(fd) != 0 && error == 0) {
+        error = errno;
+    }
+    if (error == 0 && ::rename(tmp_path.c_str(), swap_path.c_str()) != 0) {
+        error = errno;
+    }
+    if (error != 0) {
+        ::unlink(tmp_path.c_str());
+    }
+    return error;
+}
+
+// Проверка файла восстановления
+SwapInfo inspect_swap_file(const fs::path& file_path, const std::string& file_content) {
+    SwapInfo info;
+    fs::path swap_path = swap_path_for(file_path);
+    // Только обычный файл текущего пользователя: ссылку или чужую копию мог подложить
+    // любой, у кого есть право записи в папку
+    struct stat own_st;
+    if (::lstat(swap_path.c_str(), &own_st) != 0 || !S_ISREG(own_st.st_mode) || own_st.st_uid != ::geteuid()) {
+        return info;
+    }
+    std::ifstream in(swap_path, std::ios::binary);
+    if (!in) {
+        return info;
+    }
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::size_t body = 0;
+    if (content.compare(0, kSwapMagic.size(), kSwapMagic) == 0) {
+        body = content.find('\n');
+        body = body == std::string::npos ? content.size() : body + 1;
+        info.owner_pid = std::atol(content.c_str() + kSwapMagic.size());
+    }
+
+    // Процесс-владелец жив: файл сейчас открыт в другом редакторе
+    if (info.owner_pid > 0 && info.owner_pid != ::getpid() &&
+        (::kill(static_cast<pid_t>(info.owner_pid), 0) == 0 || errno == EPERM)) {
+        info.state = SwapState::InUse;
+        return info;
+    }
+
+    // Копия совпадает с файлом (с точностью до завершающего перевода строки) — восстанавливать нечего
+    std::size_t body_size = content.size() - body;
+    if (content.compare(body, body_size, file_content) == 0 ||
+        (body_size == file_content.size() + 1 && content.back() == '\n' &&
+         content.compare(body, body_size - 1, file_content) == 0)) {
+        ::unlink(swap_path.c_str());
+        return info;
+    }
+
+    info.lines = decode_buffer(content.substr(body));
+    struct stat file_st;
+    struct stat swap_st;
+    bool newer = ::stat(file_path.c_str(), &file_st) == 0 && ::stat(swap_path.c_str(), &swap_st) == 0 &&
+                 (file_st.st_mtim.tv_sec > swap_st.st_mtim.tv_sec ||
+                  (file_st.st_mtim.tv_sec == swap_st.st_mtim.tv_sec && file_st.st_mtim.tv_nsec > swap_st.st_mtim.tv_nsec));
+    info.state = newer ? SwapState::Stale : SwapState::Recoverable;
+    return info;
+}
+
+BackgroundSaver::BackgroundSaver(const fs::path& file_path)
+    : file_path_(file_path), swap_path_(swap_path_for(file_path)) {
+    worker_ = std::thread(&BackgroundSaver::run, this);
+}
+
+BackgroundSaver::~BackgroundSaver() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        pending_autosave_.reset(); // Автосохранение при выходе уже не нужно, явное — дописывается
+    }
+    wake_.notify_one();
+    worker_.join();
+}
+
+void BackgroundSaver::autosave(std::shared_ptr<const BufferSnapshot> snapshot) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_autosave_ = std::move(snapshot);
+        swap_discarded_ = false;
+    }
+    wake_.notify_one();
+}
+
+void BackgroundSaver::save(std::shared_ptr<const BufferSnapshot> snapshot) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_save_ = std::move(snapshot);
+        status_ = SaveStatus::Saving;
+    }
+    wake_.notify_one();
+}
+
+SaveStatus BackgroundSaver::status() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return status_;
+}
+
+int BackgroundSaver::last_error() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return last_error_;
+}
+
+std::uint64_t BackgroundSaver::saved_generation() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return saved_generation_;
+}
+
+void BackgroundSaver::discard_swap() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_autosave_.reset();
+    swap_discarded_ = true;
+    ::unlink(swap_path_.c_str());
+}
+
+// Поток записи: кодирование и запись идут без блокировки, редактор в это время
+// может передать новые снимки
+void BackgroundSaver::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] { return stopping_ || pending_save_ || pending_autosave_; });
+        if (pending_save_) {
+            auto snapshot = std::move(pending_save_);
+            pending_save_.reset();
+            lock.unlock();
+            int error = redactor::write_file_atomic(file_path_, encode_buffer(snapshot->lines));
+            lock.lock();
+            if (error == 0) {
+                saved_generation_ = snapshot->generation;
+                // Файл восстановления больше не нужен, если после сохранения правок не было
+                if (!pending_autosave_ || pending_autosave_->generation <= snapshot->generation) {
+                    pending_autosave_.reset();
+                    ::unlink(swap_path_.c_str());
+                }
+            } else {
+                last_error_ = error;
+            }
+            if (!pending_save_) {
+                status_ = error == 0 ? SaveStatus::Saved : SaveStatus::Failed;
+            }
+        } else if (pending_autosave_) {
+            auto snapshot = std::move(pending_autosave_);
+            pending_autosave_.reset();
+            lock.unlock();
+            int error = write_swap_file(swap_path_, swap_header() + encode_buffer(snapshot->lines));
+            lock.lock();
+            if (error != 0) {
+                last_error_ = error;
+            } else if (swap_discarded_) {
+                ::unlink(swap_path_.c_str()); // Редактор закрыт, пока шла запись
+            }
+        } else if (stopping_) {
+            return;
+        }
+    }
+}
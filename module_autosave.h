@@ -0,0 +1,101 @@
+#ifndef MODULE_AUTOSAVE_H
+#define MODULE_AUTOSAVE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Неизменяемый снимок буфера редактора: строки и номер правки, на которой он сделан.
+// Редактор продолжает менять свой буфер, а запись идёт из снимка.
+struct BufferSnapshot {
+    std::vector<std::wstring> lines;
+    std::uint64_t generation = 0;
+};
+
+// Состояние явного сохранения
+enum class SaveStatus {
+    Idle,
+    Saving,
+    Saved,
+    Failed
+};
+
+// Кодирование строк буфера в UTF-8 (каждая строка завершается переводом строки)
+std::string encode_buffer(const std::vector<std::wstring>& lines);
+
+// Декодирование UTF-8 в строки буфера (обратное encode_buffer)
+std::vector<std::wstring> decode_buffer(const std::string& content);
+
+// Путь к файлу восстановления рядом с редактируемым файлом: ".имя.swp"
+fs::path swap_path_for(const fs::path& file_path);
+
+// Состояние найденного файла восстановления
+enum class SwapState {
+    None,        // Файла нет, либо в нём то же, что в самом файле (тогда он удаляется)
+    Recoverable, // Несохранённые правки, оставшиеся после аварийного завершения
+    Stale,       // Сам файл изменён позже, чем была записана копия
+    InUse        // Файл открыт в другом запущенном редакторе
+};
+
+// Результат проверки файла восстановления
+struct SwapInfo {
+    SwapState state = SwapState::None;
+    long owner_pid = 0;              // Процесс, записавший копию (0 — неизвестен)
+    std::vector<std::wstring> lines; // Содержимое копии для Recoverable и Stale
+};
+
+// Проверка файла восстановления: копия сверяется с текущим содержимым файла
+// (file_content) и временем его изменения, а по номеру процесса в заголовке
+// определяется, не редактируется ли файл прямо сейчас
+SwapInfo inspect_swap_file(const fs::path& file_path, const std::string& file_content);
+
+// Фоновая запись буфера: автосохранение в файл восстановления и явное сохранение
+// в сам файл выполняются отдельным потоком. Каждый слот хранит только последний
+// переданный снимок: если запись не успевает, промежуточные снимки пропускаются.
+class BackgroundSaver {
+public:
+    explicit BackgroundSaver(const fs::path& file_path);
+    ~BackgroundSaver(); // Дожидается незавершённого явного сохранения
+
+    BackgroundSaver(const BackgroundSaver&) = delete;
+    BackgroundSaver& operator=(const BackgroundSaver&) = delete;
+
+    // Запись снимка в файл восстановления
+    void autosave(std::shared_ptr<const BufferSnapshot> snapshot);
+
+    // Запись снимка в сам файл; после успеха файл восстановления удаляется
+    void save(std::shared_ptr<const BufferSnapshot> snapshot);
+
+    SaveStatus status() const;
+    int last_error() const;                // errno последней неудачной записи
+    std::uint64_t saved_generation() const; // Номер правки, сохранённой в файл
+
+    // Удаление файла восстановления при штатном выходе из редактора
+    // (запись, начатая потоком до вызова, тоже будет удалена)
+    void discard_swap();
+
+private:
+    void run();
+
+    fs::path file_path_;
+    fs::path swap_path_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::shared_ptr<const BufferSnapshot> pending_autosave_;
+    std::shared_ptr<const BufferSnapshot> pending_save_;
+    SaveStatus status_ = SaveStatus::Idle;
+    int last_error_ = 0;
+    std::uint64_t saved_generation_ = 0;
+    bool swap_discarded_ = false;
+    bool stopping_ = false;
+    std::thread worker_;
+};
+
+#endif // MODULE_AUTOSAVE_H
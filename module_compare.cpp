@@ -0,0 +1,259 @@
+#include "module_compare.h"
+#include "module_read_scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+// Пара файлов с одинаковым размером, но разным временем изменения
+struct PendingPair {
+    std::size_t result_index; // Запись в результатах, статус которой уточняется
+    SnapshotEntry* a;
+    SnapshotEntry* b;
+};
+
+// Функция для соединения относительного пути папки и имени элемента
+static std::string join_relative(const std::string& dir, const std::string& name) {
+    return dir.empty() ? name : dir + "/" + name;
+}
+
+// Сравнение специальных элементов: символические ссылки — по цели, устройства — по
+// номеру устройства, каналы и сокеты — только по типу
+static bool same_special(const fs::path& a, const fs::path& b) {
+    struct stat st_a;
+    struct stat st_b;
+    if (::lstat(a.c_str(), &st_a) != 0 || ::lstat(b.c_str(), &st_b) != 0 ||
+        (st_a.st_mode & S_IFMT) != (st_b.st_mode & S_IFMT)) {
+        return false;
+    }
+    if (S_ISCHR(st_a.st_mode) || S_ISBLK(st_a.st_mode)) {
+        return st_a.st_rdev == st_b.st_rdev;
+    }
+    if (!S_ISLNK(st_a.st_mode)) {
+        return true;
+    }
+    char target_a[4096];
+    char target_b[4096];
+    ssize_t length_a = ::readlink(a.c_str(), target_a, sizeof(target_a));
+    ssize_t length_b = ::readlink(b.c_str(), target_b, sizeof(target_b));
+    return length_a >= 0 && length_a == length_b && std::equal(target_a, target_a + length_a, target_b);
+}
+
+// Побайтное сравнение двух файлов одинакового размера. Файл, который не удалось
+// прочитать, попадает в журнал ошибок, а пара считается различной.
+static bool same_contents(const fs::path& a, const fs::path& b) {
+    static const std::size_t kChunk = 1 << 20;
+    int fd_a = ::open(a.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_a < 0) {
+        record_scan_error(a, std::strerror(errno));
+        return false;
+    }
+    int fd_b = ::open(b.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_b < 0) {
+        record_scan_error(b, std::strerror(errno));
+        ::close(fd_a);
+        return false;
+    }
+    ::posix_fadvise(fd_a, 0, 0, POSIX_FADV_SEQUENTIAL);
+    ::posix_fadvise(fd_b, 0, 0, POSIX_FADV_SEQUENTIAL);
+    std::vector<char> buffer_a(kChunk);
+    std::vector<char> buffer_b(kChunk);
+    // Читает до полного буфера или конца файла; -1 — ошибка чтения
+    auto read_full = [](int fd, std::vector<char>& buffer, const fs::path& path) -> ssize_t {
+        std::size_t filled = 0;
+        while (filled < buffer.size()) {
+            ssize_t got = ::read(fd, buffer.data() + filled, buffer.size() - filled);
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got < 0) {
+                record_scan_error(path, std::strerror(errno));
+                return -1;
+            }
+            if (got == 0) {
+                break;
+            }
+            filled += static_cast<std::size_t>(got);
+        }
+        return static_cast<ssize_t>(filled);
+    };
+    bool same = true;
+    while (same) {
+        ssize_t got_a = read_full(fd_a, buffer_a, a);
+        ssize_t got_b = read_full(fd_b, buffer_b, b);
+        if (got_a < 0 || got_b < 0 || got_a != got_b ||
+            std::memcmp(buffer_a.data(), buffer_b.data(), static_cast<std::size_t>(got_a)) != 0) {
+            same = false;
+        } else if (got_a == 0) {
+            break;
+        }
+    }
+    ::close(fd_a);
+    ::close(fd_b);
+    return same;
+}
+
+// Параллельное хэширование очереди: потоки берут задания по порядку,
+// так что каждый диск читается примерно в порядке расположения файлов.
+// Возвращает отметки заданий, файлы которых прочитать не удалось.
+static std::vector<char> hash_jobs_parallel(std::vector<HashJob>& jobs, std::size_t threads) {
+    std::vector<char> failed(jobs.size(), 0);
+    if (jobs.empty()) {
+        return failed;
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, jobs.size());
+
+    std::atomic<std::size_t> next{0};
+    auto worker = [&]() {
+        for (std::size_t i = next++; i < jobs.size(); i = next++) {
+            try {
+                jobs[i].hash = calculate_file_hash64(jobs[i].path, &jobs[i].type);
+            } catch (const std::runtime_error& error) {
+                failed[i] = 1; // Файл не прочитан — хэш неизвестен
+                record_scan_error(jobs[i].path, error);
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (std::size_t t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    return failed;
+}
+
+// Сравнение двух деревьев
+std::vector<CompareEntry> compare_trees(ScanSnapshot& a, ScanSnapshot& b, const CompareOptions& options,
+                                        CompareStats* stats) {
+    std::vector<CompareEntry> results;
+    std::vector<PendingPair> pending;
+    const fs::path root_a = a.root;
+    const fs::path root_b = b.root;
+
+    // Папки, которые есть только в одном дереве, уже отмечены в родителе — их содержимое пропускается
+    for (auto& [rel_path, dir_a] : a.directories) {
+        auto it = b.directories.find(rel_path);
+        if (it == b.directories.end()) {
+            continue;
+        }
+        auto& entries_a = dir_a.entries;
+        auto& entries_b = it->second.entries;
+
+        std::size_t i = 0, j = 0;
+        while (i < entries_a.size() || j < entries_b.size()) {
+            if (j == entries_b.size() || (i < entries_a.size() && entries_a[i].name < entries_b[j].name)) {
+                results.push_back({join_relative(rel_path, entries_a[i].name), CompareStatus::OnlyInA, entries_a[i].type});
+                ++i;
+                continue;
+            }
+            if (i == entries_a.size() || entries_b[j].name < entries_a[i].name) {
+                results.push_back({join_relative(rel_path, entries_b[j].name), CompareStatus::OnlyInB, entries_b[j].type});
+                ++j;
+                continue;
+            }
+
+            SnapshotEntry& x = entries_a[i++];
+            SnapshotEntry& y = entries_b[j++];
+            std::string path = join_relative(rel_path, x.name);
+            CompareStatus status = CompareStatus::Same;
+            if (x.type != y.type) {
+                status = CompareStatus::Differs;
+            } else if (x.type == EntryType::Other) {
+                status = same_special(root_a / path, root_b / path) ? CompareStatus::Same : CompareStatus::Differs;
+            } else if (x.type == EntryType::File) {
+                if (x.size != y.size) {
+                    status = CompareStatus::Differs;
+                } else if (options.verify_content || x.mtime_ns != y.mtime_ns) {
+                    pending.push_back({results.size(), &x, &y}); // Решится после хэширования
+                }
+            }
+            results.push_back({std::move(path), status, x.type});
+        }
+    }
+
+    std::vector<HashJob> queue;
+    std::size_t reused = 0;
+    if (options.verify_content) {
+        // Проверка не полагается на хэши: файлы каждой пары сравниваются побайтно,
+        // разные пары — параллельно
+        std::size_t threads = options.threads != 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min(threads, std::max<std::size_t>(1, pending.size()));
+        std::atomic<std::size_t> next{0};
+        auto worker = [&]() {
+            for (std::size_t i = next++; i < pending.size(); i = next++) {
+                const std::string& path = results[pending[i].result_index].path;
+                results[pending[i].result_index].status =
+                    same_contents(root_a / path, root_b / path) ? CompareStatus::Same : CompareStatus::Differs;
+            }
+        };
+        std::vector<std::thread> pool;
+        for (std::size_t t = 1; t < threads; ++t) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : pool) {
+            thread.join();
+        }
+    } else {
+        // Хэшируются только файлы неоднозначных пар, для которых в снимке нет хэша
+        std::unordered_map<std::string, SnapshotEntry*> targets;
+        for (const auto& pair : pending) {
+            const std::string& path = results[pair.result_index].path;
+            for (auto [entry, root] : {std::make_pair(pair.a, &root_a), std::make_pair(pair.b, &root_b)}) {
+                HashJob job;
+                if (entry->has_hash) {
+                    reused++;
+                } else if (make_hash_job(*root / path, job)) {
+                    targets[job.path.string()] = entry;
+                    queue.push_back(std::move(job));
+                }
+            }
+        }
+
+        order_by_physical_layout(queue);
+        std::vector<char> failed = hash_jobs_parallel(queue, options.threads);
+        for (std::size_t k = 0; k < queue.size(); ++k) {
+            SnapshotEntry* entry = targets[queue[k].path.string()];
+            if (!failed[k]) {
+                entry->hash = queue[k].hash;
+                entry->has_hash = true;
+                entry->has_type = true;
+                entry->file_type = queue[k].type;
+            }
+        }
+
+        for (const auto& pair : pending) {
+            bool equal = pair.a->has_hash && pair.b->has_hash && pair.a->hash == pair.b->hash;
+            results[pair.result_index].status = equal ? CompareStatus::Same : CompareStatus::Differs;
+        }
+    }
+
+    if (stats) {
+        for (const auto& entry : results) {
+            switch (entry.status) {
+                case CompareStatus::OnlyInA: stats->only_in_a++; break;
+                case CompareStatus::OnlyInB: stats->only_in_b++; break;
+                case CompareStatus::Same: stats->same++; break;
+                case CompareStatus::Differs: stats->differs++; break;
+            }
+        }
+        stats->pairs_hashed = pending.size();
+        stats->files_hashed = options.verify_content ? pending.size() * 2 : queue.size();
+        stats->hashes_reused = reused;
+    }
+    return results;
+}
@@ -0,0 +1,53 @@
+#ifndef MODULE_COMPARE_H
+#define MODULE_COMPARE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "module_snapshot.h"
+
+// Результат сравнения элемента двух деревьев
+enum class CompareStatus {
+    OnlyInA,
+    OnlyInB,
+    Same,
+    Differs
+};
+
+// Элемент, найденный при сравнении (путь относительно корней)
+struct CompareEntry {
+    std::string path;
+    CompareStatus status;
+    EntryType type; // Тип в дереве, где элемент есть (при расхождении — в дереве A)
+};
+
+// Параметры сравнения
+struct CompareOptions {
+    bool verify_content = false; // Сравнивать пары одинакового размера побайтно, без хэшей
+    std::size_t threads = 0;     // Потоки хэширования; 0 — по числу процессоров
+};
+
+// Статистика сравнения
+struct CompareStats {
+    std::size_t only_in_a = 0;
+    std::size_t only_in_b = 0;
+    std::size_t same = 0;
+    std::size_t differs = 0;
+    std::size_t pairs_hashed = 0;  // Пары, для которых понадобилось сравнение содержимого
+    std::size_t files_hashed = 0;  // Файлы, прочитанные при сравнении (хэшированием или побайтно)
+    std::size_t hashes_reused = 0; // Хэши, взятые из снимков
+};
+
+// Сравнение двух деревьев по снимкам. Элементы сопоставляются по относительному пути;
+// файлы разного размера сразу считаются различными, с одинаковыми размером и временем
+// изменения — одинаковыми (если не задан verify_content). Остальные пары сравниваются
+// по хэшу: хэши из снимков переиспользуются, недостающие вычисляются параллельно
+// в порядке расположения файлов на диске и сохраняются в снимках. В режиме verify_content
+// хэши не используются: файлы каждой пары сравниваются побайтно.
+// Символические ссылки сравниваются по цели, устройства — по номеру устройства.
+// Папка, которой нет в одном из деревьев, выводится одной записью, без содержимого.
+// В результат попадают все элементы; записи Same нужны для полноты отчёта.
+std::vector<CompareEntry> compare_trees(ScanSnapshot& a, ScanSnapshot& b, const CompareOptions& options = CompareOptions(),
+                                        CompareStats* stats = nullptr);
+
+#endif // MODULE_COMPARE_H
@@ -0,0 +1,254 @@
+#include "module_external_sort.h"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/resource.h>
+
+namespace fs = std::filesystem;
+
+// Минимальный размер буфера чтения одной серии (в записях)
+static const std::size_t kMinReaderRecords = 256;
+
+// Наибольшее число серий, сливаемых за один проход
+static const std::size_t kMaxFanIn = 256;
+
+// Дескрипторы, оставляемые остальной программе при открытии серий
+static const rlim_t kReservedDescriptors = 64;
+
+// Последовательное чтение одной отсортированной серии через собственный буфер
+struct SpillSorter::RunReader {
+    std::ifstream file;
+    std::vector<SpillRecord> buffer;
+    std::size_t pos = 0;
+    std::size_t count = 0;
+
+    RunReader(const fs::path& path, std::size_t capacity) : file(path, std::ios::binary), buffer(capacity) {
+        if (!file) {
+            throw std::runtime_error("Не удалось открыть серию: " + path.string());
+        }
+    }
+
+    bool refill() {
+        file.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(SpillRecord));
+        count = static_cast<std::size_t>(file.gcount()) / sizeof(SpillRecord);
+        pos = 0;
+        return count > 0;
+    }
+
+    bool has_current() const { return pos < count; }
+    const SpillRecord& current() const { return buffer[pos]; }
+
+    bool advance() {
+        ++pos;
+        return pos < count || refill();
+    }
+};
+
+SpillSorter::SpillSorter(const fs::path& spill_dir, std::size_t memory_budget)
+    : spill_dir_(spill_dir),
+      memory_budget_(memory_budget),
+      buffer_capacity_(std::max<std::size_t>(memory_budget / sizeof(SpillRecord), kMinReaderRecords)) {
+    buffer_.reserve(buffer_capacity_);
+}
+
+SpillSorter::~SpillSorter() {
+    readers_.clear();
+    std::error_code ec;
+    for (const auto& run : run_files_) {
+        fs::remove(run, ec);
+    }
+}
+
+void SpillSorter::add(const SpillRecord& record) {
+    buffer_.push_back(record);
+    if (buffer_.size() >= buffer_capacity_) {
+        spill_buffer();
+    }
+}
+
+// Путь для новой серии
+fs::path SpillSorter::new_run_path() {
+    return spill_dir_ / ("run-" + std::to_string(runs_created_++) + ".bin");
+}
+
+// Сортировка буфера и сброс его на диск новой серией
+void SpillSorter::spill_buffer() {
+    std::sort(buffer_.begin(), buffer_.end());
+    fs::path run = new_run_path();
+    std::ofstream out(run, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(buffer_.data()), buffer_.size() * sizeof(SpillRecord));
+    if (!out) {
+        throw std::runtime_error("Не удалось записать серию: " + run.string());
+    }
+    run_files_.push_back(run);
+    buffer_.clear();
+}
+
+// Сколько серий можно держать открытыми одновременно с учётом лимита дескрипторов
+static std::size_t max_open_runs() {
+    struct rlimit limit;
+    if (::getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+        return kMaxFanIn;
+    }
+    if (limit.rlim_cur <= kReservedDescriptors + 2) {
+        return 2;
+    }
+    return std::min<std::size_t>(kMaxFanIn, static_cast<std::size_t>(limit.rlim_cur - kReservedDescriptors));
+}
+
+// Открытие серий [first, last) для слияния
+void SpillSorter::open_readers(std::size_t first, std::size_t last, std::size_t per_reader) {
+    readers_.clear();
+    heap_.clear();
+    for (std::size_t i = first; i < last; ++i) {
+        auto reader = std::make_unique<RunReader>(run_files_[i], per_reader);
+        if (reader->refill()) {
+            readers_.push_back(std::move(reader));
+        }
+    }
+    auto greater = [this](std::size_t a, std::size_t b) {
+        return readers_[b]->current() < readers_[a]->current();
+    };
+    for (std::size_t i = 0; i < readers_.size(); ++i) {
+        heap_.push_back(i);
+    }
+    std::make_heap(heap_.begin(), heap_.end(), greater);
+}
+
+// Следующая запись слияния открытых серий
+bool SpillSorter::pop_merged(SpillRecord& record) {
+    if (heap_.empty()) {
+        return false;
+    }
+    auto greater = [this](std::size_t a, std::size_t b) {
+        return readers_[b]->current() < readers_[a]->current();
+    };
+    std::pop_heap(heap_.begin(), heap_.end(), greater);
+    std::size_t index = heap_.back();
+    record = readers_[index]->current();
+    if (readers_[index]->advance()) {
+        std::push_heap(heap_.begin(), heap_.end(), greater);
+    } else {
+        heap_.pop_back();
+    }
+    return true;
+}
+
+void SpillSorter::finish() {
+    // Если всё поместилось в память, сбрасывать на диск не нужно
+    if (run_files_.empty()) {
+        std::sort(buffer_.begin(), buffer_.end());
+        in_memory_ = true;
+        buffer_pos_ = 0;
+        return;
+    }
+    if (!buffer_.empty()) {
+        spill_buffer();
+    }
+    buffer_.clear();
+    buffer_.shrink_to_fit();
+
+    // Число одновременно сливаемых серий ограничено бюджетом памяти (у каждой серии
+    // буфер не меньше kMinReaderRecords, ещё один буфер — для вывода промежуточной
+    // серии) и лимитом открытых файлов
+    std::size_t budget_records = std::max(memory_budget_ / sizeof(SpillRecord), kMinReaderRecords);
+    std::size_t fan_in = std::max<std::size_t>(2, std::min(budget_records / kMinReaderRecords, max_open_runs()) - 1);
+
+    // Пока серий больше, чем можно слить сразу, первые fan_in серий сливаются в одну новую.
+    // Новая серия встаёт в конец очереди, поэтому каждая запись переписывается
+    // примерно log_{fan_in}(число серий) раз.
+    std::size_t per_reader = std::max(budget_records / (fan_in + 1), kMinReaderRecords);
+    while (run_files_.size() > fan_in) {
+        open_readers(0, fan_in, per_reader);
+        fs::path run = new_run_path();
+        std::ofstream out(run, std::ios::binary | std::ios::trunc);
+        std::vector<SpillRecord> output;
+        output.reserve(per_reader);
+        SpillRecord record;
+        while (pop_merged(record)) {
+            output.push_back(record);
+            if (output.size() == per_reader) {
+                out.write(reinterpret_cast<const char*>(output.data()), output.size() * sizeof(SpillRecord));
+                output.clear();
+            }
+        }
+        out.write(reinterpret_cast<const char*>(output.data()), output.size() * sizeof(SpillRecord));
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Не удалось записать серию: " + run.string());
+        }
+        readers_.clear();
+        std::error_code ec;
+        for (std::size_t i = 0; i < fan_in; ++i) {
+            fs::remove(run_files_[i], ec);
+        }
+        run_files_.erase(run_files_.begin(), run_files_.begin() + fan_in);
+        run_files_.push_back(run);
+    }
+
+    // Последний проход: оставшиеся серии сливаются при чтении, бюджет делится между ними
+    open_readers(0, run_files_.size(), std::max(budget_records / run_files_.size(), kMinReaderRecords));
+}
+
+bool SpillSorter::next(SpillRecord& record) {
+    if (in_memory_) {
+        if (buffer_pos_ >= buffer_.size()) {
+            return false;
+        }
+        record = buffer_[buffer_pos_++];
+        return true;
+    }
+    return pop_merged(record);
+}
+
+PathStore::PathStore(const fs::path& file_path) : file_path_(file_path) {
+    out_.open(file_path_, std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        throw std::runtime_error("Не удалось создать файл путей: " + file_path_.string());
+    }
+}
+
+PathStore::~PathStore() {
+    out_.close();
+    in_.close();
+    std::error_code ec;
+    fs::remove(file_path_, ec);
+}
+
+// Сохраняет путь и возвращает его номер (смещение в файле)
+std::uint64_t PathStore::add(const fs::path& path) {
+    const std::string& text = path.native();
+    std::uint32_t length = static_cast<std::uint32_t>(text.size());
+    std::uint64_t id = offset_;
+    out_.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    out_.write(text.data(), length);
+    offset_ += sizeof(length) + length;
+    return id;
+}
+
+// Читает путь по номеру
+fs::path PathStore::get(std::uint64_t path_id) {
+    out_.flush();
+    if (!in_.is_open()) {
+        in_.open(file_path_, std::ios::binary);
+    }
+    std::uint32_t length = 0;
+    in_.clear();
+    in_.seekg(static_cast<std::streamoff>(path_id));
+    in_.read(reinterpret_cast<char*>(&length), sizeof(length));
+    std::string text(length, '\0');
+    in_.read(&text[0], length);
+    if (!in_) {
+        throw std::runtime_error("Не удалось прочитать путь из " + file_path_.string());
+    }
+    return fs::path(text);
+}
+
+// Создание уникальной временной папки для серий
+fs::path make_spill_directory(const fs::path& parent) {
+    static std::atomic<unsigned> counter{0};
+    fs::path dir = parent / ("analizator-" + std::to_string(::getpid()) + "-" + std::to_string(counter++));
+    fs::create_directories(dir);
+    return dir;
+}
@@ -0,0 +1,90 @@
+#ifndef MODULE_EXTERNAL_SORT_H
+#define MODULE_EXTERNAL_SORT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Запись о файле для внешней сортировки: (размер, хэш, номер пути)
+struct SpillRecord {
+    std::uint64_t size;
+    std::uint64_t hash;
+    std::uint64_t path_id;
+
+    bool operator<(const SpillRecord& other) const {
+        if (size != other.size) return size < other.size;
+        if (hash != other.hash) return hash < other.hash;
+        return path_id < other.path_id;
+    }
+};
+
+// Внешняя сортировка записей: пока буфер помещается в бюджет памяти, записи
+// копятся в нём; при переполнении буфер сортируется и сбрасывается на диск
+// отдельной серией. Чтение выполняется k-путевым слиянием серий; если серий больше,
+// чем позволяют бюджет памяти и лимит открытых файлов, они предварительно сливаются
+// в несколько проходов через промежуточные серии.
+class SpillSorter {
+public:
+    SpillSorter(const fs::path& spill_dir, std::size_t memory_budget);
+    ~SpillSorter();
+
+    SpillSorter(const SpillSorter&) = delete;
+    SpillSorter& operator=(const SpillSorter&) = delete;
+
+    void add(const SpillRecord& record);
+
+    // Завершает запись и подготавливает слияние
+    void finish();
+
+    // Следующая запись в порядке возрастания; false, когда записи закончились
+    bool next(SpillRecord& record);
+
+private:
+    struct RunReader;
+
+    void spill_buffer();
+    fs::path new_run_path();
+    void open_readers(std::size_t first, std::size_t last, std::size_t per_reader);
+    bool pop_merged(SpillRecord& record);
+
+    fs::path spill_dir_;
+    std::size_t memory_budget_;
+    std::size_t buffer_capacity_;
+    std::vector<SpillRecord> buffer_;
+    std::vector<fs::path> run_files_;
+    std::vector<std::unique_ptr<RunReader>> readers_;
+    std::vector<std::size_t> heap_; // Индексы читателей, упорядоченные по текущей записи
+    std::size_t buffer_pos_ = 0;    // Позиция чтения, если всё поместилось в память
+    std::size_t runs_created_ = 0;  // Для имён файлов серий
+    bool in_memory_ = false;
+};
+
+// Хранилище путей на диске: путь заменяется номером (смещением в файле)
+class PathStore {
+public:
+    explicit PathStore(const fs::path& file_path);
+    ~PathStore();
+
+    PathStore(const PathStore&) = delete;
+    PathStore& operator=(const PathStore&) = delete;
+
+    std::uint64_t add(const fs::path& path);
+    fs::path get(std::uint64_t path_id);
+
+private:
+    fs::path file_path_;
+    std::ofstream out_;
+    std::ifstream in_;
+    std::uint64_t offset_ = 0;
+};
+
+// Создание уникальной временной папки для серий
+fs::path make_spill_directory(const fs::path& parent);
+
+#endif // MODULE_EXTERNAL_SORT_H
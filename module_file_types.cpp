@@ -0,0 +1,224 @@
+#include "module_file_types.h"
+#include "module_io_policy.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Сигнатура: последовательность байт по фиксированному смещению от начала файла.
+// Короткие сигнатуры, которые встречаются и в обычном тексте, дополнительно
+// подтверждаются проверкой структуры заголовка (check).
+struct Signature {
+    std::size_t offset;
+    const char* bytes;
+    std::size_t length;
+    FileType type;
+    bool (*check)(const char* data, std::size_t size);
+};
+
+// Чтение 32-битного числа little-endian
+static std::uint32_t read_le32(const char* data) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<std::uint32_t>(bytes[3]) << 24);
+}
+
+// BMP: зарезервированные поля заголовка нулевые, размер заголовка DIB — один из известных
+static bool check_bmp(const char* data, std::size_t size) {
+    if (size < 18 || read_le32(data + 6) != 0) {
+        return false;
+    }
+    switch (read_le32(data + 14)) {
+        case 12: case 40: case 52: case 56: case 64: case 108: case 124:
+            return true;
+    }
+    return false;
+}
+
+// PE: по смещению из заголовка DOS (0x3C) находится сигнатура "PE\0\0"
+static bool check_pe(const char* data, std::size_t size) {
+    if (size < 0x40) {
+        return false;
+    }
+    std::uint32_t pe_offset = read_le32(data + 0x3C);
+    return pe_offset >= 0x40 && pe_offset <= size - 4 && std::memcmp(data + pe_offset, "PE\0\0", 4) == 0;
+}
+
+// Сценарий: после "#!" идёт абсолютный путь к интерпретатору
+static bool check_shebang(const char* data, std::size_t size) {
+    std::size_t pos = 2;
+    while (pos < size && data[pos] == ' ') {
+        ++pos;
+    }
+    return pos < size && data[pos] == '/';
+}
+
+#define SIGNATURE(offset, text, type) {offset, text, sizeof(text) - 1, FileType::type, nullptr}
+#define CHECKED_SIGNATURE(offset, text, type, check) {offset, text, sizeof(text) - 1, FileType::type, check}
+
+static const Signature kSignatures[] = {
+    SIGNATURE(0, "\x89PNG\r\n\x1a\n", Image),
+    SIGNATURE(0, "\xFF\xD8\xFF", Image),
+    SIGNATURE(0, "GIF87a", Image),
+    SIGNATURE(0, "GIF89a", Image),
+    CHECKED_SIGNATURE(0, "BM", Image, check_bmp),
+    SIGNATURE(0, "II*\0", Image),
+    SIGNATURE(0, "MM\0*", Image),
+    SIGNATURE(8, "WEBP", Image),
+    SIGNATURE(0, "ID3", Audio),
+    SIGNATURE(0, "\xFF\xFB", Audio),
+    SIGNATURE(0, "fLaC", Audio),
+    SIGNATURE(0, "OggS", Audio),
+    SIGNATURE(8, "WAVE", Audio),
+    SIGNATURE(4, "ftyp", Video),
+    SIGNATURE(0, "\x1A\x45\xDF\xA3", Video),
+    SIGNATURE(8, "AVI ", Video),
+    SIGNATURE(0, "PK\x03\x04", Archive),
+    SIGNATURE(0, "\x1F\x8B", Archive),
+    SIGNATURE(0, "BZh", Archive),
+    SIGNATURE(0, "\xFD" "7zXZ\0", Archive),
+    SIGNATURE(0, "7z\xBC\xAF\x27\x1C", Archive),
+    SIGNATURE(0, "Rar!\x1A\x07", Archive),
+    SIGNATURE(0, "\x28\xB5\x2F\xFD", Archive),
+    SIGNATURE(0, "ANPACK01", Archive),
+    SIGNATURE(257, "ustar", Archive),
+    SIGNATURE(0, "%PDF-", Document),
+    SIGNATURE(0, "\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1", Document),
+    SIGNATURE(0, "{\\rtf", Document),
+    SIGNATURE(0, "\x7F" "ELF", Executable),
+    CHECKED_SIGNATURE(0, "MZ", Executable, check_pe),
+    SIGNATURE(0, "\xCF\xFA\xED\xFE", Executable),
+    SIGNATURE(0, "\xCA\xFE\xBA\xBE", Executable),
+    CHECKED_SIGNATURE(0, "#!", Executable, check_shebang),
+    SIGNATURE(0, "SQLite format 3\0", Database),
+};
+
+#undef SIGNATURE
+#undef CHECKED_SIGNATURE
+
+// Таблица, скомпилированная один раз: для каждого смещения — списки сигнатур
+// по их первому байту, так что для файла проверяются только подходящие кандидаты
+class SignatureTable {
+public:
+    SignatureTable() {
+        for (const auto& signature : kSignatures) {
+            Bucket* bucket = nullptr;
+            for (auto& existing : buckets_) {
+                if (existing.offset == signature.offset) {
+                    bucket = &existing;
+                }
+            }
+            if (!bucket) {
+                buckets_.push_back({signature.offset, {}});
+                bucket = &buckets_.back();
+            }
+            bucket->by_first_byte[static_cast<unsigned char>(signature.bytes[0])].push_back(&signature);
+        }
+    }
+
+    // Самая длинная совпавшая сигнатура (или nullptr)
+    const Signature* match(const char* data, std::size_t size) const {
+        const Signature* best = nullptr;
+        for (const auto& bucket : buckets_) {
+            if (bucket.offset >= size) {
+                continue;
+            }
+            for (const Signature* signature : bucket.by_first_byte[static_cast<unsigned char>(data[bucket.offset])]) {
+                if (bucket.offset + signature->length <= size &&
+                    std::memcmp(data + bucket.offset, signature->bytes, signature->length) == 0 &&
+                    (!best || signature->length > best->length) &&
+                    (!signature->check || signature->check(data, size))) {
+                    best = signature;
+                }
+            }
+        }
+        return best;
+    }
+
+private:
+    struct Bucket {
+        std::size_t offset;
+        std::array<std::vector<const Signature*>, 256> by_first_byte;
+    };
+    std::vector<Bucket> buckets_;
+};
+
+static const SignatureTable& signature_table() {
+    static const SignatureTable table;
+    return table;
+}
+
+// Документы Office Open XML — это zip-архивы с характерными именами внутри
+static bool looks_like_office_document(const char* data, std::size_t size) {
+    static const char* const kMarkers[] = {"[Content_Types].xml", "word/", "xl/", "ppt/", "mimetypeapplication/vnd.oasis"};
+    for (const char* marker : kMarkers) {
+        std::size_t length = std::strlen(marker);
+        for (std::size_t i = 30; i + length <= size; ++i) {
+            if (std::memcmp(data + i, marker, length) == 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Текст: нет нулевых байт и почти нет управляющих символов (UTF-8 допускается)
+static bool looks_like_text(const char* data, std::size_t size) {
+    std::size_t control = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c == 0) {
+            return false;
+        }
+        if (c < 0x20 && c != '\n' && c != '\r' && c != '\t' && c != '\f' && c != 0x1B) {
+            ++control;
+        }
+    }
+    return control * 100 <= size;
+}
+
+// Определение типа по первым байтам
+FileType classify_sample(const char* data, std::size_t size) {
+    if (size == 0) {
+        return FileType::Unknown;
+    }
+    size = std::min(size, kFileTypeSampleSize);
+    if (const Signature* signature = signature_table().match(data, size)) {
+        if (signature->type == FileType::Archive && signature->bytes[0] == 'P' &&
+            looks_like_office_document(data, size)) {
+            return FileType::Document;
+        }
+        return signature->type;
+    }
+    return looks_like_text(data, size) ? FileType::Text : FileType::Unknown;
+}
+
+// Определение типа с чтением начала файла
+FileType classify_file(const fs::path& file_path) {
+    char sample[kFileTypeSampleSize];
+    try {
+        return classify_sample(sample, read_file_head(file_path, sample, sizeof(sample)));
+    } catch (const std::runtime_error&) {
+        return FileType::Unknown;
+    }
+}
+
+static const char* const kTypeNames[kFileTypeCount] = {
+    "unknown", "text", "image", "audio", "video", "archive", "document", "executable", "database"
+};
+
+const char* file_type_name(FileType type) {
+    return kTypeNames[static_cast<std::size_t>(type)];
+}
+
+bool parse_file_type(const std::string& name, FileType& type) {
+    for (std::size_t i = 0; i < kFileTypeCount; ++i) {
+        if (name == kTypeNames[i]) {
+            type = static_cast<FileType>(i);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,44 @@
+#ifndef MODULE_FILE_TYPES_H
+#define MODULE_FILE_TYPES_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Тип содержимого файла, определённый по сигнатуре в начале файла
+enum class FileType : std::uint8_t {
+    Unknown,
+    Text,
+    Image,
+    Audio,
+    Video,
+    Archive,
+    Document,
+    Executable,
+    Database
+};
+
+// Количество типов (для масок и таблиц)
+const std::size_t kFileTypeCount = static_cast<std::size_t>(FileType::Database) + 1;
+
+// Сколько байт из начала файла достаточно для определения типа
+const std::size_t kFileTypeSampleSize = 4096;
+
+// Определение типа по первым байтам файла (size — сколько их есть, не больше kFileTypeSampleSize).
+// Сигнатуры сравниваются по заранее скомпилированной таблице, разбитой по первому байту.
+FileType classify_sample(const char* data, std::size_t size);
+
+// Определение типа с чтением начала файла одним небольшим запросом.
+// Если файл прочитать не удалось, возвращает FileType::Unknown.
+FileType classify_file(const fs::path& file_path);
+
+// Название типа ("image", "video", ...) — в том же виде оно задаётся в правилах
+const char* file_type_name(FileType type);
+
+// Разбор названия типа; false, если тип неизвестен
+bool parse_file_type(const std::string& name, FileType& type);
+
+#endif // MODULE_FILE_TYPES_H
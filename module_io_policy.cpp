@@ -0,0 +1,275 @@
+#include "module_io_policy.h"
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+namespace fs = std::filesystem;
+
+// Размер блока чтения при анализе
+static const std::size_t kReadBlockSize = 256 * 1024;
+
+// Значения из linux/ioprio.h
+static const int kIoprioWhoProcess = 1;
+static const int kIoprioClassIdle = 3;
+static const int kIoprioClassShift = 13;
+
+// Ведро токенов: пополняется со скоростью rate в секунду, вмещает не больше burst.
+// Запрос, превышающий остаток, уводит баланс в минус, и поток спит до его погашения.
+class TokenBucket {
+public:
+    void configure(std::uint64_t rate) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rate_ = rate;
+        tokens_ = static_cast<double>(rate);
+        last_ = std::chrono::steady_clock::now();
+    }
+
+    void acquire(std::uint64_t amount) {
+        std::chrono::duration<double> wait{0};
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (rate_ == 0) {
+                return;
+            }
+            auto now = std::chrono::steady_clock::now();
+            double burst = static_cast<double>(rate_);
+            tokens_ = std::min(burst, tokens_ + std::chrono::duration<double>(now - last_).count() * rate_);
+            last_ = now;
+            tokens_ -= static_cast<double>(amount);
+            if (tokens_ < 0) {
+                wait = std::chrono::duration<double>(-tokens_ / rate_);
+            }
+        }
+        if (wait.count() > 0) {
+            std::this_thread::sleep_for(wait);
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::uint64_t rate_ = 0;
+    double tokens_ = 0;
+    std::chrono::steady_clock::time_point last_ = std::chrono::steady_clock::now();
+};
+
+static std::mutex limits_mutex;
+static IoLimits limits;
+static TokenBucket byte_bucket;
+static TokenBucket op_bucket;
+
+// Разбор ограничений из строки
+bool parse_io_limits(const std::string& spec, IoLimits& result, std::string& error) {
+    std::stringstream stream(spec);
+    std::string token;
+    while (stream >> token) {
+        std::string key = token;
+        std::string value;
+        auto eq = token.find('=');
+        if (eq != std::string::npos) {
+            key = token.substr(0, eq);
+            value = token.substr(eq + 1);
+        }
+        try {
+            if (key == "background") {
+                result.background = true;
+            } else if (key == "nocache") {
+                result.drop_cache = true;
+            } else if (key == "bw") {
+                std::size_t pos = 0;
+                std::uint64_t rate = std::stoull(value, &pos);
+                std::string suffix = value.substr(pos);
+                if (suffix == "K" || suffix == "k") rate <<= 10;
+                else if (suffix == "M" || suffix == "m") rate <<= 20;
+                else if (suffix == "G" || suffix == "g") rate <<= 30;
+                else if (!suffix.empty()) throw std::invalid_argument(suffix);
+                result.bytes_per_second = rate;
+            } else if (key == "iops") {
+                result.iops = std::stoull(value);
+            } else {
+                error = "Неизвестный параметр: " + token;
+                return false;
+            }
+        } catch (const std::exception&) {
+            error = "Неверное значение: " + token;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Приоритеты процесса до включения фонового режима
+static bool priority_lowered = false;
+static int saved_ioprio = 0;
+static int saved_nice = 0;
+
+// Понижение приоритетов с запоминанием прежних
+static int lower_priority() {
+    long ioprio = ::syscall(SYS_ioprio_get, kIoprioWhoProcess, 0);
+    if (ioprio < 0) {
+        return errno;
+    }
+    errno = 0;
+    int nice = ::getpriority(PRIO_PROCESS, 0);
+    if (nice == -1 && errno != 0) {
+        return errno;
+    }
+    // Класс idle: диск достаётся анализу только когда он больше никому не нужен
+    if (::syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, kIoprioClassIdle << kIoprioClassShift) != 0) {
+        return errno;
+    }
+    saved_ioprio = static_cast<int>(ioprio);
+    saved_nice = nice;
+    priority_lowered = true;
+    if (::setpriority(PRIO_PROCESS, 0, 19) != 0) {
+        return errno;
+    }
+    return 0;
+}
+
+// Восстановление приоритетов, запомненных при включении фонового режима
+static int restore_priority() {
+    if (::syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, saved_ioprio) != 0) {
+        return errno;
+    }
+    if (::setpriority(PRIO_PROCESS, 0, saved_nice) != 0) {
+        return errno;
+    }
+    priority_lowered = false;
+    return 0;
+}
+
+// Установка ограничений для процесса
+int set_io_limits(const IoLimits& new_limits) {
+    std::lock_guard<std::mutex> lock(limits_mutex);
+    int error = 0;
+    if (new_limits.background && !priority_lowered) {
+        error = lower_priority();
+    } else if (!new_limits.background && priority_lowered) {
+        error = restore_priority();
+    }
+    limits = new_limits;
+    limits.background = priority_lowered; // Отражает фактическое состояние приоритетов
+    byte_bucket.configure(new_limits.bytes_per_second);
+    op_bucket.configure(new_limits.iops);
+    return error;
+}
+
+IoLimits current_io_limits() {
+    std::lock_guard<std::mutex> lock(limits_mutex);
+    return limits;
+}
+
+void throttle_io(std::size_t bytes) {
+    op_bucket.acquire(1);
+    if (bytes > 0) {
+        byte_bucket.acquire(bytes);
+    }
+}
+
+// Проверка, есть ли в page cache страницы участка файла [offset, offset + length) — их нельзя
+// выбрасывать, они нужны кому-то ещё. Проверяется только участок, который сейчас будет
+// прочитан: решение о сбросе кэша принимается для каждого блока отдельно, а память
+// под карту страниц не зависит от размера файла.
+static bool range_has_cached_pages(int fd, off_t offset, std::size_t length) {
+    if (length == 0) {
+        return false;
+    }
+    long page_size = ::sysconf(_SC_PAGESIZE);
+    off_t start = offset - offset % page_size;
+    length += static_cast<std::size_t>(offset - start);
+    void* map = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, start);
+    if (map == MAP_FAILED) {
+        return true; // Не знаем — ведём себя осторожно
+    }
+    unsigned char resident[kReadBlockSize / 4096 + 2];
+    std::size_t pages = (length + page_size - 1) / page_size;
+    bool cached = pages > sizeof(resident) || ::mincore(map, length, resident) != 0 ||
+                  std::any_of(resident, resident + pages, [](unsigned char page) { return page & 1; });
+    ::munmap(map, length);
+    return cached;
+}
+
+// Открытие файла для анализа; бросает std::system_error, если открыть не удалось
+static int open_for_analysis(const fs::path& file_path) {
+    // O_NOATIME не меняет время доступа, но доступен только владельцу файла
+    int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+    if (fd < 0 && errno == EPERM) {
+        fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Не удалось открыть файл " + file_path.string());
+    }
+    return fd;
+}
+
+// Последовательное чтение файла блоками
+void read_file_blocks(const fs::path& file_path, const std::function<void(const char*, std::size_t)>& on_block) {
+    IoLimits active = current_io_limits();
+    int fd = open_for_analysis(file_path);
+
+    struct stat st;
+    bool drop_cache = active.drop_cache && ::fstat(fd, &st) == 0;
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    std::vector<char> buffer(kReadBlockSize);
+    off_t offset = 0;
+    while (true) {
+        // Блок, часть которого уже была в кэше, после чтения в нём и остаётся
+        bool drop_block = drop_cache && offset < st.st_size &&
+                          !range_has_cached_pages(fd, offset, std::min<std::size_t>(buffer.size(), st.st_size - offset));
+        op_bucket.acquire(1);
+        ssize_t count = ::read(fd, buffer.data(), buffer.size());
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "Ошибка чтения файла " + file_path.string());
+        }
+        if (count == 0) {
+            break;
+        }
+        byte_bucket.acquire(static_cast<std::uint64_t>(count));
+        on_block(buffer.data(), static_cast<std::size_t>(count));
+        if (drop_block) {
+            ::posix_fadvise(fd, offset, count, POSIX_FADV_DONTNEED);
+        }
+        offset += count;
+    }
+    ::close(fd);
+}
+
+// Чтение начала файла одним запросом
+std::size_t read_file_head(const fs::path& file_path, char* buffer, std::size_t size) {
+    IoLimits active = current_io_limits();
+    int fd = open_for_analysis(file_path);
+    bool drop_cache = active.drop_cache && !range_has_cached_pages(fd, 0, std::min(size, kReadBlockSize));
+
+    op_bucket.acquire(1);
+    ssize_t count;
+    do {
+        count = ::pread(fd, buffer, size, 0);
+    } while (count < 0 && errno == EINTR);
+    if (count < 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "Ошибка чтения файла " + file_path.string());
+    }
+    byte_bucket.acquire(static_cast<std::uint64_t>(count));
+    if (drop_cache) {
+        ::posix_fadvise(fd, 0, count, POSIX_FADV_DONTNEED);
+    }
+    ::close(fd);
+    return static_cast<std::size_t>(count);
+}
@@ -0,0 +1,44 @@
+#ifndef MODULE_IO_POLICY_H
+#define MODULE_IO_POLICY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <functional>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Ограничения ввода-вывода для сканирования на рабочем сервере
+struct IoLimits {
+    bool background = false;            // Приоритет ввода-вывода idle и минимальный приоритет процесса
+    bool drop_cache = false;            // Не оставлять прочитанные при анализе данные в page cache
+    std::uint64_t bytes_per_second = 0; // 0 — без ограничения
+    std::uint64_t iops = 0;             // 0 — без ограничения
+};
+
+// Разбор ограничений из строки вида "background bw=20M iops=200 nocache"
+bool parse_io_limits(const std::string& spec, IoLimits& limits, std::string& error);
+
+// Установка ограничений для всего процесса. В фоновом режиме приоритеты ввода-вывода
+// и процесса понижаются, прежние значения запоминаются и восстанавливаются, когда
+// фоновый режим выключают. Возвращает 0 или errno, если приоритет изменить не удалось;
+// повысить nice обратно без CAP_SYS_NICE ядро может не позволить — тогда фоновый
+// режим в current_io_limits() остаётся включённым.
+int set_io_limits(const IoLimits& limits);
+
+// Текущие ограничения
+IoLimits current_io_limits();
+
+// Учёт одной операции ввода-вывода размером bytes; при превышении лимитов поток ждёт
+void throttle_io(std::size_t bytes);
+
+// Последовательное чтение файла блоками с учётом ограничений; блоки передаются в on_block.
+// Бросает std::system_error (код — errno), если файл не удалось открыть или прочитать.
+void read_file_blocks(const fs::path& file_path, const std::function<void(const char*, std::size_t)>& on_block);
+
+// Чтение не более size байт из начала файла одним запросом с учётом ограничений.
+// Возвращает количество прочитанных байт; при ошибке бросает std::system_error.
+std::size_t read_file_head(const fs::path& file_path, char* buffer, std::size_t size);
+
+#endif // MODULE_IO_POLICY_H
@@ -0,0 +1,274 @@
+#include "module_read_scheduler.h"
+#include "module_io_policy.h"
+#include "module_analization.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+namespace fs = std::filesystem;
+
+// Сколько байт следующего файла просить ядро прочитать заранее
+static const off_t kReadaheadBytes = 8 * 1024 * 1024;
+
+// Потоки хэширования для твердотельных устройств
+static const std::size_t kSolidStateThreads = 8;
+
+// Потоки хэширования для устройств, тип которых определить не удалось (сетевые, FUSE):
+// параллельное чтение с неизвестного носителя может оказаться чтением с одного диска
+static const std::size_t kUnknownDeviceThreads = 1;
+
+// Создание задания по пути
+bool make_hash_job(const fs::path& path, HashJob& job) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    job.path = path;
+    job.size = static_cast<std::uint64_t>(st.st_size);
+    job.device = static_cast<std::uint64_t>(st.st_dev);
+    job.inode = static_cast<std::uint64_t>(st.st_ino);
+    job.physical = 0;
+    job.hash = 0;
+    return true;
+}
+
+// Физическое смещение первого экстента файла; false, если FIEMAP недоступен
+static bool first_extent(const fs::path& path, std::uint64_t& physical, bool& unsupported) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    // Заголовок fiemap и место под один экстент
+    alignas(struct fiemap) char buffer[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+    std::memset(buffer, 0, sizeof(buffer));
+    auto* map = reinterpret_cast<struct fiemap*>(buffer);
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+
+    bool ok = ::ioctl(fd, FS_IOC_FIEMAP, map) == 0;
+    if (!ok && (errno == EOPNOTSUPP || errno == ENOTTY)) {
+        unsupported = true;
+    }
+    ::close(fd);
+    if (!ok || map->fm_mapped_extents == 0) {
+        return false;
+    }
+    physical = map->fm_extents[0].fe_physical;
+    return true;
+}
+
+// Упорядочивание очереди по физическому расположению
+void order_by_physical_layout(std::vector<HashJob>& jobs) {
+    if (jobs.size() < 2) {
+        return;
+    }
+
+    // FIEMAP запрашивается, пока файловая система его поддерживает; файлы без
+    // экстентов (пустые, встроенные в inode) упорядочиваются по inode
+    bool unsupported = false;
+    bool have_extents = false;
+    for (auto& job : jobs) {
+        if (unsupported) {
+            break;
+        }
+        if (first_extent(job.path, job.physical, unsupported)) {
+            have_extents = true;
+        }
+    }
+
+    if (have_extents && !unsupported) {
+        std::sort(jobs.begin(), jobs.end(), [](const HashJob& a, const HashJob& b) {
+            if (a.device != b.device) return a.device < b.device;
+            if (a.physical != b.physical) return a.physical < b.physical;
+            return a.inode < b.inode;
+        });
+    } else {
+        std::sort(jobs.begin(), jobs.end(), [](const HashJob& a, const HashJob& b) {
+            if (a.device != b.device) return a.device < b.device;
+            return a.inode < b.inode;
+        });
+    }
+}
+
+// Подсказка ядру прочитать начало файла заранее
+static void hint_readahead(const fs::path& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    ::posix_fadvise(fd, 0, kReadaheadBytes, POSIX_FADV_WILLNEED);
+    ::close(fd); // Упреждающее чтение продолжается и после закрытия
+}
+
+// Хэширование очереди в заданном порядке
+bool hash_jobs_in_order(std::vector<HashJob>& jobs,
+                        const std::function<std::uint64_t(const fs::path&, FileType*)>& hash_file,
+                        const std::function<bool(HashJob&)>& on_hashed) {
+    // В режиме без засорения кэша заранее читать нельзя: данные останутся в page cache
+    bool readahead = !current_io_limits().drop_cache;
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        if (readahead && i + 1 < jobs.size()) {
+            hint_readahead(jobs[i + 1].path);
+        }
+        try {
+            jobs[i].hash = hash_file(jobs[i].path, &jobs[i].type);
+        } catch (const std::runtime_error& error) {
+            jobs[i].failed = true;
+            record_scan_error(jobs[i].path, error);
+        }
+        if (on_hashed && !on_hashed(jobs[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Признак вращающегося диска из /sys/dev/block/<major>:<minor>/queue/rotational
+static bool read_rotational(dev_t dev, int& rotational) {
+    char path[96];
+    std::snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/queue/rotational", major(dev), minor(dev));
+    std::ifstream in(path);
+    if (!in) {
+        // У раздела очереди нет, её параметры — у всего диска
+        std::snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/../queue/rotational", major(dev), minor(dev));
+        in.open(path);
+    }
+    return static_cast<bool>(in >> rotational);
+}
+
+// Блочное устройство, на котором смонтирована файловая система с анонимным st_dev
+// (btrfs, у которой st_dev свой для каждого подтома): по /proc/self/mountinfo находится
+// источник монтирования, и если это файл устройства, берётся его номер
+static bool backing_block_device(dev_t dev, dev_t& block) {
+    std::ifstream in("/proc/self/mountinfo");
+    std::string line;
+    char wanted[32];
+    std::snprintf(wanted, sizeof(wanted), "%u:%u", major(dev), minor(dev));
+    while (std::getline(in, line)) {
+        // Формат: id parent major:minor root mount-point options [поля...] - fstype source options
+        std::size_t first = line.find(' ');
+        std::size_t second = first == std::string::npos ? first : line.find(' ', first + 1);
+        std::size_t third = second == std::string::npos ? second : line.find(' ', second + 1);
+        if (third == std::string::npos || line.compare(second + 1, third - second - 1, wanted) != 0) {
+            continue;
+        }
+        std::size_t separator = line.find(" - ");
+        if (separator == std::string::npos) {
+            continue;
+        }
+        std::size_t source = line.find(' ', separator + 3);
+        if (source == std::string::npos) {
+            continue;
+        }
+        std::size_t source_end = line.find(' ', source + 1);
+        std::string device_path = line.substr(source + 1, source_end == std::string::npos
+                                                              ? std::string::npos : source_end - source - 1);
+        struct stat st;
+        if (::stat(device_path.c_str(), &st) == 0 && S_ISBLK(st.st_mode)) {
+            block = st.st_rdev;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Параллельность устройства по /sys/dev/block/<major>:<minor>/queue/rotational
+std::size_t device_parallelism(std::uint64_t device) {
+    std::size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+    dev_t dev = static_cast<dev_t>(device);
+    int rotational = 0;
+    dev_t block = 0;
+    if (read_rotational(dev, rotational) ||
+        (backing_block_device(dev, block) && read_rotational(block, rotational))) {
+        return rotational ? 1 : std::min(cpus, kSolidStateThreads);
+    }
+    return std::min(cpus, kUnknownDeviceThreads);
+}
+
+// Хэширование пулами по устройствам
+bool hash_jobs_by_device(std::vector<HashJob>& jobs,
+                         const std::function<std::uint64_t(const fs::path&, FileType*)>& hash_file,
+                         const std::function<bool(HashJob&)>& on_hashed) {
+    std::map<std::uint64_t, std::vector<std::size_t>> by_device; // Индексы заданий каждого устройства
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        by_device[jobs[i].device].push_back(i);
+    }
+    if (by_device.size() == 1 && device_parallelism(by_device.begin()->first) == 1) {
+        return hash_jobs_in_order(jobs, hash_file, on_hashed);
+    }
+
+    std::mutex callback_mutex;
+    std::atomic<bool> stopped{false};
+    auto finish_job = [&](HashJob& job) {
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        if (!stopped && on_hashed && !on_hashed(job)) {
+            stopped = true;
+        }
+    };
+
+    struct DevicePool {
+        std::vector<std::size_t> indices;
+        std::atomic<std::size_t> next{0};
+    };
+    std::vector<std::unique_ptr<DevicePool>> pools;
+    std::vector<std::thread> threads;
+    for (auto& [device, indices] : by_device) {
+        pools.push_back(std::make_unique<DevicePool>());
+        DevicePool* pool = pools.back().get();
+        pool->indices = std::move(indices);
+        std::size_t pool_size = std::min(device_parallelism(device), pool->indices.size());
+        if (pool_size == 1) {
+            // Вращающийся диск: один поток в порядке расположения, с упреждающим чтением
+            threads.emplace_back([&, pool]() {
+                std::vector<HashJob> ordered;
+                ordered.reserve(pool->indices.size());
+                for (std::size_t index : pool->indices) {
+                    ordered.push_back(std::move(jobs[index]));
+                }
+                hash_jobs_in_order(ordered, hash_file, [&](HashJob& job) {
+                    finish_job(job);
+                    return !stopped;
+                });
+                for (std::size_t k = 0; k < ordered.size(); ++k) {
+                    jobs[pool->indices[k]] = std::move(ordered[k]);
+                }
+            });
+            continue;
+        }
+        for (std::size_t t = 0; t < pool_size; ++t) {
+            threads.emplace_back([&, pool]() {
+                for (std::size_t k = pool->next++; k < pool->indices.size() && !stopped; k = pool->next++) {
+                    HashJob& job = jobs[pool->indices[k]];
+                    try {
+                        job.hash = hash_file(job.path, &job.type);
+                    } catch (const std::runtime_error& error) {
+                        job.failed = true;
+                        record_scan_error(job.path, error);
+                    }
+                    finish_job(job);
+                }
+            });
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return !stopped;
+}
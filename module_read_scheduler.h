@@ -0,0 +1,55 @@
+#ifndef MODULE_READ_SCHEDULER_H
+#define MODULE_READ_SCHEDULER_H
+
+#include <cstdint>
+#include <vector>
+#include <filesystem>
+#include <functional>
+#include "module_file_types.h"
+
+namespace fs = std::filesystem;
+
+// Задание на хэширование одного файла
+struct HashJob {
+    fs::path path;
+    std::uint64_t size = 0;
+    std::uint64_t device = 0;
+    std::uint64_t inode = 0;
+    std::uint64_t physical = 0; // Физическое смещение первого экстента (если известно)
+    std::uint64_t hash = 0;
+    FileType type = FileType::Unknown; // Определяется при хэшировании
+    bool failed = false;               // Файл не удалось прочитать (ошибка в журнале анализа)
+};
+
+// Создание задания по пути (stat для размера, устройства и inode); false, если файл недоступен
+bool make_hash_job(const fs::path& path, HashJob& job);
+
+// Упорядочивание очереди по физическому расположению на диске: по первому экстенту
+// из FIEMAP, а на файловых системах без FIEMAP — по номеру inode
+void order_by_physical_layout(std::vector<HashJob>& jobs);
+
+// Хэширование очереди в заданном порядке. Пока читается текущий файл, ядру
+// заранее сообщается о следующем (POSIX_FADV_WILLNEED), чтобы чтение шло без простоев.
+// hash_file получает путь и место для типа файла, определённого по первому блоку.
+// Файл, который не удалось прочитать, отмечается failed и записывается в журнал ошибок анализа.
+// on_hashed вызывается после каждого файла; если он вернёт false, хэширование прекращается.
+bool hash_jobs_in_order(std::vector<HashJob>& jobs,
+                        const std::function<std::uint64_t(const fs::path&, FileType*)>& hash_file,
+                        const std::function<bool(HashJob&)>& on_hashed = nullptr);
+
+// Число одновременных чтений, которое выдерживает устройство без потери скорости:
+// 1 для вращающихся дисков (параллельные чтения заставляют головку метаться),
+// несколько потоков для SSD/NVMe. Для анонимных st_dev (btrfs) тип берётся у блочного
+// устройства из источника монтирования; если и его нет в /sys (tmpfs, сеть) — 1 поток.
+std::size_t device_parallelism(std::uint64_t device);
+
+// Хэширование очереди пулами по устройствам: у каждого устройства (st_dev) свой пул
+// размером device_parallelism, поэтому медленный диск не задерживает остальные.
+// Внутри устройства порядок очереди сохраняется; пул из одного потока работает
+// как hash_jobs_in_order (с упреждающим чтением). on_hashed вызывается последовательно
+// под общей блокировкой; если он вернёт false, все пулы останавливаются.
+bool hash_jobs_by_device(std::vector<HashJob>& jobs,
+                         const std::function<std::uint64_t(const fs::path&, FileType*)>& hash_file,
+                         const std::function<bool(HashJob&)>& on_hashed = nullptr);
+
+#endif // MODULE_READ_SCHEDULER_H
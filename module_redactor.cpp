@@ -3,6 +3,15 @@
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <algorithm>
 
 namespace fs = std::filesystem;
 namespace redactor {
@@ -79,6 +88,540 @@ std::vector<std::string> list_directory(const fs::path& dir_path) {
     return contents;
 }
 
+// ---- Операции относительно дескриптора директории ----
+
+DirHandle::DirHandle(const fs::path& dir_path) {
+    fd_ = ::open(dir_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd_ < 0) {
+        error_ = errno;
+    }
+}
+
+DirHandle::~DirHandle() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+DirHandle::DirHandle(DirHandle&& other) noexcept : fd_(other.fd_), error_(other.error_) {
+    other.fd_ = -1;
+}
+
+DirHandle& DirHandle::operator=(DirHandle&& other) noexcept {
+    if (this != &other) {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+        fd_ = other.fd_;
+        error_ = other.error_;
+        other.fd_ = -1;
+    }
+    return *this;
+}
+
+DirHandle DirHandle::open_subdirectory(const std::string& name) const {
+    DirHandle sub;
+    sub.fd_ = ::openat(fd_, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (sub.fd_ < 0) {
+        sub.error_ = errno;
+    }
+    return sub;
+}
+
+// Функция для записи всего буфера в дескриптор
+static int write_all(int fd, const std::string& content) {
+    const char* data = content.data();
+    std::size_t left = content.size();
+    while (left > 0) {
+        ssize_t written = ::write(fd, data, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        data += written;
+        left -= static_cast<std::size_t>(written);
+    }
+    return 0;
+}
+
+// Функция для создания файла
+int create_file_at(const DirHandle& dir, const std::string& name, const std::string& content) {
+    int fd = ::openat(dir.fd(), name.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        return errno;
+    }
+    int error = write_all(fd, content);
+    if (::close(fd) != 0 && error == 0) {
+        error = errno;
+    }
+    return error;
+}
+
+// Функция для удаления файла
+int delete_file_at(const DirHandle& dir, const std::string& name) {
+    return ::unlinkat(dir.fd(), name.c_str(), 0) == 0 ? 0 : errno;
+}
+
+// Функция для создания папки
+int create_directory_at(const DirHandle& dir, const std::string& name) {
+    return ::mkdirat(dir.fd(), name.c_str(), 0777) == 0 ? 0 : errno;
+}
+
+// Функция для очистки содержимого открытой папки (рекурсивно)
+static int remove_contents_at(const DirHandle& dir) {
+    // fdopendir забирает дескриптор, поэтому открываем отдельный
+    int list_fd = ::openat(dir.fd(), ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (list_fd < 0) {
+        return errno;
+    }
+    DIR* stream = ::fdopendir(list_fd);
+    if (!stream) {
+        int error = errno;
+        ::close(list_fd);
+        return error;
+    }
+
+    int first_error = 0;
+    while (dirent* entry = ::readdir(stream)) {
+        if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        int error = 0;
+        if (entry->d_type == DT_DIR) {
+            error = delete_directory_at(dir, entry->d_name);
+        } else if (entry->d_type == DT_UNKNOWN) {
+            error = delete_entry_at(dir, entry->d_name);
+        } else {
+            error = delete_file_at(dir, entry->d_name);
+        }
+        if (error != 0 && first_error == 0) {
+            first_error = error;
+        }
+    }
+    ::closedir(stream);
+    return first_error;
+}
+
+// Функция для рекурсивного удаления папки
+int delete_directory_at(const DirHandle& dir, const std::string& name) {
+    DirHandle sub = dir.open_subdirectory(name);
+    if (!sub.is_open()) {
+        return sub.error();
+    }
+    int error = remove_contents_at(sub);
+    if (error != 0) {
+        return error;
+    }
+    return ::unlinkat(dir.fd(), name.c_str(), AT_REMOVEDIR) == 0 ? 0 : errno;
+}
+
+// Функция для удаления файла или папки
+int delete_entry_at(const DirHandle& dir, const std::string& name) {
+    // Сначала пробуем удалить как файл: для папок ядро вернёт EISDIR (или EPERM)
+    if (::unlinkat(dir.fd(), name.c_str(), 0) == 0) {
+        return 0;
+    }
+    int error = errno;
+    if (error == EISDIR || error == EPERM) {
+        return delete_directory_at(dir, name);
+    }
+    return error;
+}
+
+// Функция для получения списка файлов и папок
+int list_directory_at(const DirHandle& dir, std::vector<DirEntry>& entries) {
+    int list_fd = ::openat(dir.fd(), ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (list_fd < 0) {
+        return errno;
+    }
+    DIR* stream = ::fdopendir(list_fd);
+    if (!stream) {
+        int error = errno;
+        ::close(list_fd);
+        return error;
+    }
+
+    while (dirent* entry = ::readdir(stream)) {
+        if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        bool is_directory = entry->d_type == DT_DIR;
+        // stat нужен только для ссылок и файловых систем без d_type
+        if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            is_directory = ::fstatat(dir.fd(), entry->d_name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+        }
+        entries.push_back({entry->d_name, is_directory});
+    }
+    ::closedir(stream);
+    return 0;
+}
+
+// Пакетное создание файлов
+std::vector<BatchResult> create_files_at(const DirHandle& dir, const std::vector<std::string>& names) {
+    std::vector<BatchResult> results;
+    results.reserve(names.size());
+    for (const auto& name : names) {
+        results.push_back({name, create_file_at(dir, name)});
+    }
+    return results;
+}
+
+// Пакетное создание папок
+std::vector<BatchResult> create_directories_at(const DirHandle& dir, const std::vector<std::string>& names) {
+    std::vector<BatchResult> results;
+    results.reserve(names.size());
+    for (const auto& name : names) {
+        results.push_back({name, create_directory_at(dir, name)});
+    }
+    return results;
+}
+
+// Пакетное удаление файлов и папок
+std::vector<BatchResult> delete_entries_at(const DirHandle& dir, const std::vector<std::string>& names) {
+    std::vector<BatchResult> results;
+    results.reserve(names.size());
+    for (const auto& name : names) {
+        results.push_back({name, delete_entry_at(dir, name)});
+    }
+    return results;
+}
+
+// ---- Копирование и перемещение ----
+
+// Размер порции, копируемой за один системный вызов (между вызовами обновляется прогресс)
+static const std::size_t kCopyChunk = 8 * 1024 * 1024;
+
+// Счётчик прогресса для операции над несколькими файлами
+struct CopyState {
+    std::uint64_t copied = 0;
+    std::uint64_t total = 0;
+    const CopyProgress* progress = nullptr;
+
+    bool report() const {
+        return !progress || !*progress || (*progress)(copied, total);
+    }
+};
+
+// Перенос содержимого между дескрипторами внутри ядра
+static int transfer_contents(int in_fd, int out_fd, std::uint64_t size, CopyState& state) {
+    bool use_sendfile = false;
+    std::uint64_t left = size;
+    while (left > 0) {
+        std::size_t chunk = static_cast<std::size_t>(std::min<std::uint64_t>(left, kCopyChunk));
+        ssize_t done = use_sendfile ? ::sendfile(out_fd, in_fd, nullptr, chunk)
+                                    : ::copy_file_range(in_fd, nullptr, out_fd, nullptr, chunk, 0);
+        if (done < 0) {
+            if (errno == EINTR) continue;
+            // Старые ядра не умеют copy_file_range между файловыми системами
+            if (!use_sendfile && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+                use_sendfile = true;
+                continue;
+            }
+            return errno;
+        }
+        if (done == 0) {
+            break; // Файл укоротился во время копирования
+        }
+        left -= static_cast<std::uint64_t>(done);
+        state.copied += static_cast<std::uint64_t>(done);
+        if (!state.report()) {
+            return ECANCELED;
+        }
+    }
+    return 0;
+}
+
+// Перенос прав, владельца и времени с источника на копию. Владелец меняется первым:
+// fchown сбрасывает биты setuid/setgid, поэтому права выставляются после него.
+static void copy_metadata(int out_fd, const struct stat& st) {
+    if (::fchown(out_fd, st.st_uid, st.st_gid) != 0) {
+        // Сменить владельца может только root — копия остаётся за текущим пользователем
+    }
+    ::fchmod(out_fd, st.st_mode & 07777);
+    struct timespec times[2] = {st.st_atim, st.st_mtim};
+    ::futimens(out_fd, times);
+}
+
+// Копирование одного файла с учётом общего прогресса
+static int copy_file_impl(const fs::path& source, const fs::path& destination, CopyState& state) {
+    int in_fd = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in_fd < 0) {
+        return errno;
+    }
+    struct stat st;
+    if (::fstat(in_fd, &st) != 0) {
+        int error = errno;
+        ::close(in_fd);
+        return error;
+    }
+    int out_fd = ::open(destination.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 07777);
+    if (out_fd < 0) {
+        int error = errno;
+        ::close(in_fd);
+        return error;
+    }
+
+    int error = transfer_contents(in_fd, out_fd, static_cast<std::uint64_t>(st.st_size), state);
+    // Копируется размер, известный при открытии: если источник за это время изменился,
+    // копия неполна, и при перемещении источник с недокопированными данными был бы удалён
+    struct stat after;
+    if (error == 0 && (::fstat(in_fd, &after) != 0 || after.st_size != st.st_size ||
+                       after.st_mtim.tv_sec != st.st_mtim.tv_sec || after.st_mtim.tv_nsec != st.st_mtim.tv_nsec)) {
+        error = EAGAIN;
+    }
+    if (error == 0) {
+        copy_metadata(out_fd, st);
+    }
+    if (::close(out_fd) != 0 && error == 0) {
+        error = errno;
+    }
+    ::close(in_fd);
+    if (error != 0) {
+        ::unlink(destination.c_str()); // Не оставляем недокопированный файл
+    }
+    return error;
+}
+
+// Функция для копирования файла
+int copy_file(const fs::path& source, const fs::path& destination, const CopyProgress& progress) {
+    struct stat st;
+    if (::stat(source.c_str(), &st) != 0) {
+        return errno;
+    }
+    CopyState state;
+    state.total = static_cast<std::uint64_t>(st.st_size);
+    state.progress = &progress;
+    return copy_file_impl(source, destination, state);
+}
+
+// Подсчёт общего объёма папки для прогресса
+static std::uint64_t tree_size(const fs::path& dir_path) {
+    std::uint64_t total = 0;
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(dir_path, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (it->is_regular_file(ec) && !it->is_symlink(ec)) {
+            total += it->file_size(ec);
+        }
+    }
+    return total;
+}
+
+// Рекурсивное копирование папки
+static int copy_tree_impl(const fs::path& source, const fs::path& destination, CopyState& state) {
+    struct stat st;
+    if (::lstat(source.c_str(), &st) != 0) {
+        return errno;
+    }
+    if (S_ISLNK(st.st_mode)) {
+        std::string target(static_cast<std::size_t>(st.st_size) + 1, '\0');
+        ssize_t length = ::readlink(source.c_str(), &target[0], target.size());
+        if (length < 0) {
+            return errno;
+        }
+        target.resize(static_cast<std::size_t>(length));
+        return ::symlink(target.c_str(), destination.c_str()) == 0 ? 0 : errno;
+    }
+    if (S_ISREG(st.st_mode)) {
+        return copy_file_impl(source, destination, state);
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        // Каналы, сокеты и устройства создаются заново (для устройств нужны права root —
+        // иначе ошибка, и перемещение не удалит источник)
+        if (::mknod(destination.c_str(), st.st_mode & (S_IFMT | 07777), st.st_rdev) != 0) {
+            return errno;
+        }
+        if (::lchown(destination.c_str(), st.st_uid, st.st_gid) != 0) {
+            // Сменить владельца может только root
+        }
+        ::chmod(destination.c_str(), st.st_mode & 07777);
+        struct timespec times[2] = {st.st_atim, st.st_mtim};
+        ::utimensat(AT_FDCWD, destination.c_str(), times, AT_SYMLINK_NOFOLLOW);
+        return 0;
+    }
+
+    if (::mkdir(destination.c_str(), 0700) != 0) {
+        return errno;
+    }
+    DIR* stream = ::opendir(source.c_str());
+    if (!stream) {
+        return errno;
+    }
+    int error = 0;
+    while (dirent* entry = ::readdir(stream)) {
+        if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        error = copy_tree_impl(source / entry->d_name, destination / entry->d_name, state);
+        if (error != 0) {
+            break;
+        }
+    }
+    ::closedir(stream);
+
+    // Метаданные папки переносятся после содержимого, иначе время изменения собьётся
+    int dir_fd = ::open(destination.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        copy_metadata(dir_fd, st);
+        ::close(dir_fd);
+    }
+    return error;
+}
+
+// Проверка, лежит ли путь внутри папки (или совпадает с ней)
+static bool is_within(const fs::path& path, const fs::path& dir) {
+    auto mismatch = std::mismatch(dir.begin(), dir.end(), path.begin(), path.end());
+    return mismatch.first == dir.end();
+}
+
+// Функция для рекурсивного копирования папки
+int copy_tree(const fs::path& source, const fs::path& destination, const CopyProgress& progress) {
+    // Копия папки внутрь самой себя никогда бы не закончилась
+    std::error_code ec;
+    fs::path canonical_source = fs::canonical(source, ec);
+    if (ec) {
+        return ec.value();
+    }
+    fs::path canonical_destination = fs::weakly_canonical(destination, ec);
+    if (ec) {
+        return ec.value();
+    }
+    if (fs::is_directory(fs::symlink_status(canonical_source)) && is_within(canonical_destination, canonical_source)) {
+        return EINVAL;
+    }
+
+    struct stat st;
+    if (::lstat(destination.c_str(), &st) == 0) {
+        return EEXIST;
+    }
+    CopyState state;
+    state.total = tree_size(source);
+    state.progress = &progress;
+    int error = copy_tree_impl(source, destination, state);
+    if (error != 0) {
+        // Недокопированное дерево удаляется целиком
+        DirHandle parent(destination.has_parent_path() ? destination.parent_path() : fs::path("."));
+        if (parent.is_open()) {
+            delete_entry_at(parent, destination.filename().string());
+        }
+    }
+    return error;
+}
+
+// Функция для перемещения файла или папки
+int move_path(const fs::path& source, const fs::path& destination, const CopyProgress& progress) {
+    // RENAME_NOREPLACE: существующий файл назначения не перезаписывается
+    if (::renameat2(AT_FDCWD, source.c_str(), AT_FDCWD, destination.c_str(), RENAME_NOREPLACE) == 0) {
+        return 0;
+    }
+    if (errno != EXDEV) {
+        return errno;
+    }
+
+    // Другая файловая система: копируем и удаляем источник только после успешного копирования
+    struct stat before;
+    if (::lstat(source.c_str(), &before) != 0) {
+        return errno;
+    }
+    int error = copy_tree(source, destination, progress);
+    if (error != 0) {
+        return error;
+    }
+    // Источник, изменившийся за время копирования, не удаляется: копия могла его не застать
+    struct stat after;
+    if (::lstat(source.c_str(), &after) != 0 || after.st_ino != before.st_ino || after.st_size != before.st_size ||
+        after.st_mtim.tv_sec != before.st_mtim.tv_sec || after.st_mtim.tv_nsec != before.st_mtim.tv_nsec) {
+        DirHandle target_parent(destination.has_parent_path() ? destination.parent_path() : fs::path("."));
+        if (target_parent.is_open()) {
+            delete_entry_at(target_parent, destination.filename().string());
+        }
+        return EAGAIN;
+    }
+    DirHandle parent(source.has_parent_path() ? source.parent_path() : fs::path("."));
+    if (!parent.is_open()) {
+        return parent.error();
+    }
+    return delete_entry_at(parent, source.filename().string());
+}
+
+// Функция для создания уникального временного файла в папке целевого файла
+int create_temp_file(const fs::path& target, fs::path& tmp_path, int& fd) {
+    fs::path dir = target.has_parent_path() ? target.parent_path() : fs::path(".");
+    std::string name_template = (dir / ("." + target.filename().string() + ".XXXXXX")).string();
+    // mkostemp открывает файл с O_EXCL: чужой файл или ссылка с таким именем не будут перезаписаны
+    fd = ::mkostemp(&name_template[0], O_CLOEXEC);
+    if (fd < 0) {
+        return errno;
+    }
+    tmp_path = name_template;
+    return 0;
+}
+
+// Путь, на который в итоге указывает символическая ссылка (цель может не существовать)
+static int resolve_symlinks(const fs::path& file_path, fs::path& resolved) {
+    resolved = file_path;
+    for (int depth = 0; depth < 40; ++depth) {
+        char target[4096];
+        ssize_t length = ::readlink(resolved.c_str(), target, sizeof(target));
+        if (length < 0) {
+            return errno == EINVAL || errno == ENOENT ? 0 : errno; // Не ссылка или файла ещё нет
+        }
+        if (static_cast<std::size_t>(length) == sizeof(target)) {
+            return ENAMETOOLONG;
+        }
+        fs::path next(std::string(target, static_cast<std::size_t>(length)));
+        resolved = next.is_absolute() ? next : resolved.parent_path() / next;
+    }
+    return ELOOP;
+}
+
+// Функция для атомарной записи файла
+int write_file_atomic(const fs::path& file_path, const std::string& content) {
+    // Символическая ссылка остаётся на месте: заменяется файл, на который она указывает
+    fs::path target;
+    int error = resolve_symlinks(file_path, target);
+    if (error != 0) {
+        return error;
+    }
+    struct stat st;
+    bool existed = ::stat(target.c_str(), &st) == 0;
+    fs::path tmp_path;
+    int fd = -1;
+    error = create_temp_file(target, tmp_path, fd);
+    if (error != 0) {
+        return error;
+    }
+    // Владелец и права переносятся с исходного файла; сменить владельца может
+    // только root, поэтому EPERM не считается ошибкой
+    if (existed && ::fchown(fd, st.st_uid, st.st_gid) != 0 && errno != EPERM) {
+        error = errno;
+    }
+    if (error == 0 && ::fchmod(fd, existed ? st.st_mode & 07777 : 0644) != 0) {
+        error = errno;
+    }
+    if (error == 0) {
+        error = write_all(fd, content);
+    }
+    if (error == 0 && ::fsync(fd) != 0) {
+        error = errno;
+    }
+    if (::close(fd) != 0 && error == 0) {
+        error = errno;
+    }
+    if (error == 0 && ::rename(tmp_path.c_str(), target.c_str()) != 0) {
+        error = errno;
+    }
+    if (error != 0) {
+        ::unlink(tmp_path.c_str());
+    }
+    return error;
+}
+
+// Текстовое описание кода ошибки
+std::string error_message(int error) {
+    return std::strerror(error);
+}
+
 } // namespace redactor
 
 
@@ -4,6 +4,8 @@
 #include <string>
 #include <filesystem>
 #include <vector>
+#include <functional>
+#include <cstdint>
 
 namespace fs = std::filesystem;
 
@@ -30,6 +32,103 @@ bool delete_directory(const fs::path& dir_path);
 // Функция для получения списка файлов и папок в директории
 std::vector<std::string> list_directory(const fs::path& dir_path);
 
+// ---- Операции относительно дескриптора директории (openat/mkdirat/unlinkat) ----
+// Функции ниже не делают предварительных проверок fs::exists: результат
+// операции возвращается кодом ошибки (0 при успехе, иначе значение errno).
+
+// Дескриптор открытой директории (RAII-обёртка над файловым дескриптором)
+class DirHandle {
+public:
+    DirHandle() = default;
+    explicit DirHandle(const fs::path& dir_path);
+    ~DirHandle();
+
+    DirHandle(const DirHandle&) = delete;
+    DirHandle& operator=(const DirHandle&) = delete;
+    DirHandle(DirHandle&& other) noexcept;
+    DirHandle& operator=(DirHandle&& other) noexcept;
+
+    bool is_open() const { return fd_ >= 0; }
+    int fd() const { return fd_; }
+    int error() const { return error_; } // errno, если открыть не удалось
+
+    // Открывает вложенную директорию относительно текущей
+    DirHandle open_subdirectory(const std::string& name) const;
+
+private:
+    int fd_ = -1;
+    int error_ = 0;
+};
+
+// Элемент содержимого директории
+struct DirEntry {
+    std::string name;
+    bool is_directory;
+};
+
+// Результат одной операции в пакете
+struct BatchResult {
+    std::string name;
+    int error; // 0 при успехе, иначе errno
+};
+
+// Функция для создания файла (ошибка EEXIST, если файл уже есть)
+int create_file_at(const DirHandle& dir, const std::string& name, const std::string& content = "");
+
+// Функция для удаления файла
+int delete_file_at(const DirHandle& dir, const std::string& name);
+
+// Функция для создания папки
+int create_directory_at(const DirHandle& dir, const std::string& name);
+
+// Функция для рекурсивного удаления папки
+int delete_directory_at(const DirHandle& dir, const std::string& name);
+
+// Функция для удаления файла или папки (тип определяется без лишнего stat)
+int delete_entry_at(const DirHandle& dir, const std::string& name);
+
+// Функция для получения списка файлов и папок (тип берётся из d_type)
+int list_directory_at(const DirHandle& dir, std::vector<DirEntry>& entries);
+
+// Пакетные операции над множеством элементов одной директории
+std::vector<BatchResult> create_files_at(const DirHandle& dir, const std::vector<std::string>& names);
+std::vector<BatchResult> create_directories_at(const DirHandle& dir, const std::vector<std::string>& names);
+std::vector<BatchResult> delete_entries_at(const DirHandle& dir, const std::vector<std::string>& names);
+
+// ---- Копирование и перемещение ----
+// Данные копируются внутри ядра (copy_file_range, при его недоступности — sendfile)
+// и не проходят через буферы программы. Права, владелец и время изменения сохраняются.
+
+// Обработчик прогресса: скопировано байт из общего количества; false — отменить операцию
+using CopyProgress = std::function<bool(std::uint64_t copied, std::uint64_t total)>;
+
+// Функция для копирования файла (ошибка EEXIST, если файл назначения уже есть;
+// EAGAIN, если источник изменился во время копирования — копия тогда удаляется)
+int copy_file(const fs::path& source, const fs::path& destination, const CopyProgress& progress = nullptr);
+
+// Функция для рекурсивного копирования папки. EINVAL, если назначение лежит внутри
+// копируемой папки; EEXIST, если назначение уже существует. При ошибке частично
+// скопированное дерево удаляется. Каналы, сокеты и устройства создаются заново через mknod.
+int copy_tree(const fs::path& source, const fs::path& destination, const CopyProgress& progress = nullptr);
+
+// Функция для перемещения файла или папки: в пределах одной файловой системы —
+// rename, иначе копирование с последующим удалением источника. Если источник изменился
+// за время копирования, он остаётся на месте, копия удаляется, и возвращается EAGAIN.
+int move_path(const fs::path& source, const fs::path& destination, const CopyProgress& progress = nullptr);
+
+// Функция для создания уникального временного файла (права 0600) в той же папке, что
+// и target, чтобы его можно было переименовать в target. Возвращает 0 или errno.
+int create_temp_file(const fs::path& target, fs::path& tmp_path, int& fd);
+
+// Функция для атомарной записи файла: содержимое пишется в уникальный временный файл
+// рядом, сбрасывается на диск и подменяет исходный через rename. Права и владелец
+// исходного файла сохраняются; для символической ссылки перезаписывается файл,
+// на который она указывает. Возвращает 0 или errno.
+int write_file_atomic(const fs::path& file_path, const std::string& content);
+
+// Текстовое описание кода ошибки
+std::string error_message(int error);
+
 } // namespace redactor
 
 #endif // MODULE_REDACTOR_H
\ No newline at end of file
@@ -0,0 +1,311 @@
+#include "module_replace.h"
+#include <algorithm>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+namespace redactor {
+
+// Размер блока чтения и порог сброса результата на диск
+static const std::size_t kReplaceBufferSize = 1 << 20;
+
+// Участок для поиска строки за один вызов
+static const std::size_t kLiteralSpan = 1 << 20;
+
+// Участок для поиска регулярного выражения: std::regex рекурсивен, и глубина
+// рекурсии растёт с длиной участка, поэтому он намного меньше блока чтения
+static const std::size_t kRegexSpan = 16 << 10;
+
+// Экранирование строки для использования внутри регулярного выражения
+static std::string escape_regex(const std::string& text) {
+    std::string result;
+    for (char c : text) {
+        if (std::strchr("^$\\.*+?()[]{}|/", c) && c != '\0') {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result;
+}
+
+StreamReplacer::StreamReplacer(const std::string& pattern, const std::string& replacement, const ReplaceOptions& options)
+    : pattern_(pattern), replacement_(replacement) {
+    if (pattern_.empty()) {
+        error_ = EINVAL;
+        return;
+    }
+    if (!options.regex && !options.ignore_case) {
+        // Строка ищется алгоритмом Бойера — Мура — Хорспула
+        searcher_.emplace(pattern_.cbegin(), pattern_.cend());
+        keep_ = pattern_.size();
+        span_ = std::max(kLiteralSpan, 2 * keep_);
+        return;
+    }
+    auto flags = std::regex::ECMAScript | std::regex::optimize;
+    if (options.ignore_case) {
+        flags |= std::regex::icase;
+    }
+    if (!options.regex) {
+        // Строка без учёта регистра ищется как регулярное выражение, а замена вставляется как есть
+        std::string escaped;
+        for (char c : replacement_) {
+            escaped += c == '$' ? "$$" : std::string(1, c);
+        }
+        replacement_ = escaped;
+    }
+    try {
+        regex_.emplace(options.regex ? pattern_ : escape_regex(pattern_), flags);
+    } catch (const std::regex_error&) {
+        error_ = EINVAL;
+        return;
+    }
+    keep_ = options.regex ? std::max<std::size_t>(options.max_match, 1) : pattern_.size();
+    span_ = std::max(kRegexSpan, 2 * keep_);
+}
+
+// Поиск первого совпадения в window_[pos, limit)
+bool StreamReplacer::find(std::size_t pos, std::size_t limit, bool at_end, std::size_t& start, std::size_t& end) {
+    auto first = window_.cbegin() + pos;
+    auto last = window_.cbegin() + limit;
+    if (searcher_) {
+        auto it = std::search(first, last, *searcher_);
+        if (it == last) {
+            return false;
+        }
+        start = it - window_.cbegin();
+        end = start + pattern_.size();
+        return true;
+    }
+    // Пустые совпадения не заменяются; ^ и $ относятся к началу и концу всего файла
+    auto flags = std::regex_constants::match_not_null;
+    if (pos > 0) {
+        flags |= std::regex_constants::match_prev_avail;
+    }
+    if (!at_end) {
+        flags |= std::regex_constants::match_not_eol;
+    }
+    if (!std::regex_search(first, last, match_, *regex_, flags)) {
+        return false;
+    }
+    start = pos + match_.position(0);
+    end = start + match_.length(0);
+    return true;
+}
+
+// Обработка окна: всё, что уже не может стать частью совпадения, выводится в out.
+// Совпадение, начавшееся в последних keep_ байтах, может продолжиться в следующем
+// блоке, поэтому этот хвост остаётся в окне до поступления новых данных.
+void StreamReplacer::process(bool at_eof, std::string& out) {
+    std::size_t pos = history_;
+    while (true) {
+        std::size_t limit = std::min(window_.size(), pos + span_);
+        bool at_end = at_eof && limit == window_.size();
+        if (!at_end && limit - pos <= keep_) {
+            break; // Данных недостаточно, ждём следующего блока
+        }
+        std::size_t safe = at_end ? limit : limit - keep_;
+        std::size_t start = 0;
+        std::size_t end = 0;
+        if (!find(pos, limit, at_end, start, end) || (!at_end && start >= safe)) {
+            out.append(window_, pos, safe - pos);
+            pos = safe;
+            if (at_end) {
+                break;
+            }
+            continue;
+        }
+        out.append(window_, pos, start - pos);
+        if (regex_) {
+            out += match_.format(replacement_);
+        } else {
+            out += replacement_;
+        }
+        matches_++;
+        pos = end;
+    }
+    // Один выведенный символ остаётся перед окном для проверки границ слова и начала строки
+    std::size_t drop = (regex_ && pos > 0) ? pos - 1 : pos;
+    window_.erase(0, drop);
+    history_ = pos - drop;
+}
+
+void StreamReplacer::feed(const char* data, std::size_t size, std::string& out) {
+    if (error_ != 0) {
+        return;
+    }
+    window_.append(data, size);
+    process(false, out);
+}
+
+void StreamReplacer::finish(std::string& out) {
+    if (error_ != 0) {
+        return;
+    }
+    process(true, out);
+    window_.clear();
+    history_ = 0;
+}
+
+// Функция для замены в строке
+int replace_in_string(const std::string& input, const std::string& pattern, const std::string& replacement,
+                      const ReplaceOptions& options, std::string& output, std::uint64_t* matches) {
+    StreamReplacer replacer(pattern, replacement, options);
+    if (replacer.error() != 0) {
+        return replacer.error();
+    }
+    output.clear();
+    replacer.feed(input.data(), input.size(), output);
+    replacer.finish(output);
+    if (matches) {
+        *matches = replacer.matches();
+    }
+    return 0;
+}
+
+// Запись всего содержимого в дескриптор
+static int write_all(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return 0;
+}
+
+// Копирование первых size байт исходного файла (участка до первого совпадения)
+static int copy_prefix(int in, int out, std::uint64_t size, std::vector<char>& buffer) {
+    off_t offset = 0;
+    while (static_cast<std::uint64_t>(offset) < size) {
+        std::size_t chunk = static_cast<std::size_t>(std::min<std::uint64_t>(buffer.size(), size - offset));
+        ssize_t got = ::pread(in, buffer.data(), chunk, offset);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        if (got == 0) {
+            return EIO; // Файл укоротили во время замены
+        }
+        int error = write_all(out, buffer.data(), static_cast<std::size_t>(got));
+        if (error != 0) {
+            return error;
+        }
+        offset += got;
+    }
+    return 0;
+}
+
+// Функция для замены в файле. Пока совпадений нет, результат совпадает с началом
+// исходного файла и никуда не пишется; временный файл создаётся при первом совпадении,
+// и в него сначала копируется уже прочитанное начало.
+int replace_in_file(const fs::path& file_path, const std::string& pattern, const std::string& replacement,
+                    const ReplaceOptions& options, std::uint64_t* matches, const CopyProgress& progress) {
+    StreamReplacer replacer(pattern, replacement, options);
+    if (replacer.error() != 0) {
+        return replacer.error();
+    }
+    std::error_code ec;
+    fs::path target = fs::canonical(file_path, ec); // Замена идёт в файле, на который указывает ссылка
+    if (ec) {
+        return ec.value();
+    }
+    int in = ::open(target.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return errno;
+    }
+    struct stat st;
+    if (::fstat(in, &st) != 0) {
+        int error = errno;
+        ::close(in);
+        return error;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        ::close(in);
+        return S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+    }
+    ::posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    fs::path tmp_path;
+    int out = -1; // Временный файл создаётся при первом совпадении; пока он не открыт, удалять нечего
+    std::vector<char> buffer(kReplaceBufferSize);
+    std::string pending;
+    pending.reserve(kReplaceBufferSize * 2);
+    std::uint64_t unchanged_prefix = 0;
+    std::uint64_t done = 0;
+    int error = 0;
+    while (error == 0) {
+        ssize_t got = ::read(in, buffer.data(), buffer.size());
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            error = errno;
+            break;
+        }
+        if (got == 0) {
+            replacer.finish(pending);
+        } else {
+            replacer.feed(buffer.data(), static_cast<std::size_t>(got), pending);
+            done += static_cast<std::uint64_t>(got);
+        }
+        if (out < 0 && replacer.matches() == 0) {
+            unchanged_prefix += pending.size();
+            pending.clear();
+        } else {
+            if (out < 0) {
+                // Уникальное имя: посторонний файл рядом с целевым не перезаписывается
+                error = create_temp_file(target, tmp_path, out);
+                if (error != 0) {
+                    break;
+                }
+                // Сменить владельца может только root, иначе файл остаётся за текущим пользователем
+                if (::fchown(out, st.st_uid, st.st_gid) != 0 && errno != EPERM) {
+                    error = errno;
+                    break;
+                }
+                if (::fchmod(out, st.st_mode & 07777) != 0) {
+                    error = errno;
+                    break;
+                }
+                error = copy_prefix(in, out, unchanged_prefix, buffer);
+            }
+            if (error == 0 && (pending.size() >= kReplaceBufferSize || got == 0)) {
+                error = write_all(out, pending.data(), pending.size());
+                pending.clear();
+            }
+        }
+        if (got == 0) {
+            break;
+        }
+        if (progress && !progress(done, static_cast<std::uint64_t>(st.st_size))) {
+            error = ECANCELED;
+        }
+    }
+    ::close(in);
+
+    if (out >= 0) {
+        if (error == 0 && ::fsync(out) != 0) {
+            error = errno;
+        }
+        if (::close(out) != 0 && error == 0) {
+            error = errno;
+        }
+        if (error == 0 && ::rename(tmp_path.c_str(), target.c_str()) != 0) {
+            error = errno;
+        }
+        if (error != 0) {
+            ::unlink(tmp_path.c_str());
+        }
+    }
+    if (matches) {
+        *matches = replacer.matches();
+    }
+    return error;
+}
+
+} // namespace redactor
@@ -0,0 +1,76 @@
+#ifndef MODULE_REPLACE_H
+#define MODULE_REPLACE_H
+
+#include "module_redactor.h"
+#include <string>
+#include <regex>
+#include <optional>
+#include <functional>
+#include <filesystem>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+namespace redactor {
+
+// ---- Потоковый поиск и замена ----
+// Данные проходят через буфер фиксированного размера, поэтому файлы любого
+// размера обрабатываются с постоянным расходом памяти. Совпадения, попавшие
+// на границу блоков, находятся так же, как внутри блока.
+
+// Параметры замены
+struct ReplaceOptions {
+    bool regex = false;          // Образец — регулярное выражение ECMAScript, в замене доступны $1, $& и т.д.
+    bool ignore_case = false;    // Без учёта регистра (только для латиницы)
+    std::size_t max_match = 4096; // Наибольшая длина совпадения регулярного выражения, которую нужно найти целиком
+};
+
+// Потоковая замена: входные данные подаются блоками через feed, готовый результат
+// дописывается в out. Совпадение регулярного выражения, которое может продолжиться
+// в следующем блоке, откладывается до его поступления.
+class StreamReplacer {
+public:
+    StreamReplacer(const std::string& pattern, const std::string& replacement, const ReplaceOptions& options = ReplaceOptions());
+
+    StreamReplacer(const StreamReplacer&) = delete;
+    StreamReplacer& operator=(const StreamReplacer&) = delete;
+
+    int error() const { return error_; } // EINVAL, если образец пуст или регулярное выражение некорректно
+
+    void feed(const char* data, std::size_t size, std::string& out);
+    void finish(std::string& out); // Конец входных данных
+
+    std::uint64_t matches() const { return matches_; }
+
+private:
+    void process(bool at_eof, std::string& out);
+    bool find(std::size_t pos, std::size_t limit, bool at_end, std::size_t& start, std::size_t& end);
+
+    std::string pattern_;
+    std::string replacement_;
+    std::string window_;    // Необработанный хвост входных данных
+    std::size_t history_ = 0; // Уже выведенный символ перед window_ (для ^ и \b в регулярных выражениях)
+    std::size_t keep_ = 0;  // Сколько байт в конце окна может оказаться началом совпадения
+    std::size_t span_ = 0;  // Размер участка, передаваемого в поиск за один раз
+    std::optional<std::regex> regex_;
+    std::optional<std::boyer_moore_horspool_searcher<std::string::const_iterator>> searcher_;
+    std::smatch match_;
+    std::uint64_t matches_ = 0;
+    int error_ = 0;
+};
+
+// Функция для замены в строке (используется редактором для буфера в памяти)
+int replace_in_string(const std::string& input, const std::string& pattern, const std::string& replacement,
+                      const ReplaceOptions& options, std::string& output, std::uint64_t* matches = nullptr);
+
+// Функция для замены в файле. Результат пишется во временный файл рядом, сбрасывается
+// на диск и атомарно подменяет исходный; права и владелец сохраняются. Если совпадений
+// нет, файл не переписывается. Символическая ссылка сохраняется, меняется её цель.
+// Возвращает 0 или errno (ECANCELED, если обработчик прогресса отменил операцию).
+int replace_in_file(const fs::path& file_path, const std::string& pattern, const std::string& replacement,
+                    const ReplaceOptions& options, std::uint64_t* matches = nullptr,
+                    const CopyProgress& progress = nullptr);
+
+} // namespace redactor
+
+#endif // MODULE_REPLACE_H
@@ -0,0 +1,197 @@
+#include "module_report.h"
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+#include <ctime>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+static const std::int64_t kSecondsPerDay = 24 * 60 * 60;
+
+// Разбор названия поля времени
+bool parse_time_field(const std::string& name, TimeField& field) {
+    if (name == "mtime") field = TimeField::Modified;
+    else if (name == "atime") field = TimeField::Accessed;
+    else if (name == "ctime") field = TimeField::Changed;
+    else return false;
+    return true;
+}
+
+// Границы интервалов гистограммы: от порога до 90 дней, до полугода, года, двух и пяти лет
+static std::vector<AgeBucket> make_age_buckets(int days_threshold) {
+    const int bounds[] = {90, 180, 365, 730, 1825};
+    std::vector<AgeBucket> buckets;
+    int lower = days_threshold + 1;
+    for (int bound : bounds) {
+        if (bound > lower) {
+            buckets.push_back({lower, bound});
+            lower = bound;
+        }
+    }
+    buckets.push_back({lower, -1});
+    return buckets;
+}
+
+// Непустые элементы статистики по типам, по убыванию занимаемого места
+static std::vector<TypeStats> sorted_type_stats(std::vector<TypeStats>& by_type) {
+    std::vector<TypeStats> types;
+    for (std::size_t i = 0; i < by_type.size(); ++i) {
+        if (by_type[i].files > 0) {
+            by_type[i].type = static_cast<FileType>(i);
+            types.push_back(by_type[i]);
+        }
+    }
+    std::sort(types.begin(), types.end(), [](const TypeStats& a, const TypeStats& b) { return a.bytes > b.bytes; });
+    return types;
+}
+
+// Построение отчёта
+UnusedFilesReport build_unused_report(const fs::path& directory, int days_threshold, std::size_t top_k,
+                                      TimeField field, std::size_t top_extensions, const ScanMatcher& matcher) {
+    UnusedFilesReport report;
+    report.age_buckets = make_age_buckets(days_threshold);
+
+    // Минимальная куча: на вершине самый маленький из отобранных файлов
+    auto smaller = [](const FileInfo& a, const FileInfo& b) { return a.size > b.size; };
+    std::priority_queue<FileInfo, std::vector<FileInfo>, decltype(smaller)> largest(smaller);
+    std::unordered_map<std::string, ExtensionStats> by_extension;
+    std::vector<TypeStats> by_type(kFileTypeCount);
+
+    unsigned int mask = STATX_SIZE;
+    mask |= field == TimeField::Accessed ? STATX_ATIME : field == TimeField::Changed ? STATX_CTIME : STATX_MTIME;
+    const std::time_t now = std::time(nullptr);
+
+    walk_directory_tree(directory, matcher, [&](const fs::directory_entry& entry) {
+        struct statx stx;
+        if (::statx(AT_FDCWD, entry.path().c_str(), AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, mask, &stx) != 0) {
+            return true;
+        }
+        const struct statx_timestamp& ts = field == TimeField::Accessed ? stx.stx_atime
+                                         : field == TimeField::Changed ? stx.stx_ctime : stx.stx_mtime;
+        std::time_t last_used = static_cast<std::time_t>(ts.tv_sec);
+        std::int64_t age_days = (now - last_used) / kSecondsPerDay;
+        if (age_days <= days_threshold) {
+            return true;
+        }
+        FileType type = classify_file(entry.path());
+        if (!matcher.accept_type(type)) {
+            return true;
+        }
+
+        report.total_files++;
+        report.total_bytes += stx.stx_size;
+
+        for (auto& bucket : report.age_buckets) {
+            if (age_days >= bucket.min_days && (bucket.max_days < 0 || age_days < bucket.max_days)) {
+                bucket.files++;
+                bucket.bytes += stx.stx_size;
+                break;
+            }
+        }
+
+        std::string extension = entry.path().extension().string();
+        auto& stats = by_extension[extension];
+        stats.files++;
+        stats.bytes += stx.stx_size;
+        by_type[static_cast<std::size_t>(type)].files++;
+        by_type[static_cast<std::size_t>(type)].bytes += stx.stx_size;
+
+        // FileInfo создаётся, только если файл попадает в первые top_k
+        if (top_k > 0 && (largest.size() < top_k || stx.stx_size > largest.top().size)) {
+            largest.push({entry.path().filename().string(), entry.path().string(),
+                          static_cast<std::size_t>(stx.stx_size), last_used});
+            if (largest.size() > top_k) {
+                largest.pop();
+            }
+        }
+        return true;
+    });
+
+    report.largest.reserve(largest.size());
+    while (!largest.empty()) {
+        report.largest.push_back(largest.top());
+        largest.pop();
+    }
+    std::reverse(report.largest.begin(), report.largest.end());
+
+    report.extensions.reserve(by_extension.size());
+    for (auto& [extension, stats] : by_extension) {
+        stats.extension = extension.empty() ? "(без расширения)" : extension;
+        report.extensions.push_back(std::move(stats));
+    }
+    auto more_bytes = [](const ExtensionStats& a, const ExtensionStats& b) { return a.bytes > b.bytes; };
+    if (report.extensions.size() > top_extensions) {
+        std::partial_sort(report.extensions.begin(), report.extensions.begin() + top_extensions,
+                          report.extensions.end(), more_bytes);
+        report.extensions.resize(top_extensions);
+    } else {
+        std::sort(report.extensions.begin(), report.extensions.end(), more_bytes);
+    }
+
+    report.types = sorted_type_stats(by_type);
+    return report;
+}
+
+// Текстовое представление отчёта
+std::vector<std::string> format_report_summary(const UnusedFilesReport& report) {
+    std::vector<std::string> lines;
+    char buffer[256];
+
+    std::snprintf(buffer, sizeof(buffer), "Всего: %llu файлов, %llu байт",
+                  static_cast<unsigned long long>(report.total_files), static_cast<unsigned long long>(report.total_bytes));
+    lines.push_back(buffer);
+
+    lines.push_back("По возрасту:");
+    for (const auto& bucket : report.age_buckets) {
+        if (bucket.max_days < 0) {
+            std::snprintf(buffer, sizeof(buffer), "  от %d дней: %llu файлов, %llu байт", bucket.min_days,
+                          static_cast<unsigned long long>(bucket.files), static_cast<unsigned long long>(bucket.bytes));
+        } else {
+            std::snprintf(buffer, sizeof(buffer), "  %d-%d дней: %llu файлов, %llu байт", bucket.min_days, bucket.max_days - 1,
+                          static_cast<unsigned long long>(bucket.files), static_cast<unsigned long long>(bucket.bytes));
+        }
+        lines.push_back(buffer);
+    }
+
+    lines.push_back("По расширениям:");
+    for (const auto& stats : report.extensions) {
+        std::snprintf(buffer, sizeof(buffer), "  %s: %llu файлов, %llu байт", stats.extension.c_str(),
+                      static_cast<unsigned long long>(stats.files), static_cast<unsigned long long>(stats.bytes));
+        lines.push_back(buffer);
+    }
+
+    auto type_lines = format_type_stats("По типам:", report.types);
+    lines.insert(lines.end(), type_lines.begin(), type_lines.end());
+    return lines;
+}
+
+// Группировка дубликатов по типам
+std::vector<TypeStats> summarize_duplicates_by_type(const std::vector<std::vector<fs::path>>& groups,
+                                                    const std::vector<FileType>& group_types,
+                                                    const std::vector<DuplicateGroupInfo>& group_info) {
+    std::vector<TypeStats> by_type(kFileTypeCount);
+    for (std::size_t i = 0; i < groups.size() && i < group_types.size(); ++i) {
+        std::error_code ec;
+        std::uintmax_t size = i < group_info.size() ? group_info[i].file_size : fs::file_size(groups[i].front(), ec);
+        auto& stats = by_type[static_cast<std::size_t>(group_types[i])];
+        stats.files += groups[i].size() - 1;
+        stats.bytes += ec ? 0 : size * (groups[i].size() - 1);
+    }
+    return sorted_type_stats(by_type);
+}
+
+// Текстовое представление статистики по типам
+std::vector<std::string> format_type_stats(const std::string& title, const std::vector<TypeStats>& types) {
+    std::vector<std::string> lines;
+    char buffer[256];
+    lines.push_back(title);
+    for (const auto& stats : types) {
+        std::snprintf(buffer, sizeof(buffer), "  %s: %llu файлов, %llu байт", file_type_name(stats.type),
+                      static_cast<unsigned long long>(stats.files), static_cast<unsigned long long>(stats.bytes));
+        lines.push_back(buffer);
+    }
+    return lines;
+}
@@ -0,0 +1,75 @@
+#ifndef MODULE_REPORT_H
+#define MODULE_REPORT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include "module_analization.h"
+#include "module_scan_rules.h"
+
+namespace fs = std::filesystem;
+
+// Какое время считать временем последнего использования файла
+enum class TimeField {
+    Modified, // mtime
+    Accessed, // atime
+    Changed   // ctime
+};
+
+// Разбор названия поля времени ("mtime", "atime", "ctime")
+bool parse_time_field(const std::string& name, TimeField& field);
+
+// Интервал возраста файлов в гистограмме
+struct AgeBucket {
+    int min_days;  // Нижняя граница (включительно)
+    int max_days;  // Верхняя граница (не включительно), -1 — без ограничения
+    std::uint64_t files = 0;
+    std::uint64_t bytes = 0;
+};
+
+// Статистика по расширению файла
+struct ExtensionStats {
+    std::string extension;
+    std::uint64_t files = 0;
+    std::uint64_t bytes = 0;
+};
+
+// Статистика по типу содержимого
+struct TypeStats {
+    FileType type = FileType::Unknown;
+    std::uint64_t files = 0;
+    std::uint64_t bytes = 0;
+};
+
+// Сводный отчёт о давно не использовавшихся файлах
+struct UnusedFilesReport {
+    std::uint64_t total_files = 0;
+    std::uint64_t total_bytes = 0;
+    std::vector<FileInfo> largest;           // Самые большие файлы, по убыванию размера
+    std::vector<AgeBucket> age_buckets;      // Распределение по возрасту
+    std::vector<ExtensionStats> extensions;  // Расширения по убыванию занимаемого места
+    std::vector<TypeStats> types;            // Типы содержимого по убыванию занимаемого места
+};
+
+// Построение отчёта за один обход: список самых больших файлов хранится в
+// ограниченной куче, остальное — в счётчиках, поэтому память не зависит от
+// количества найденных файлов. Время берётся через statx из выбранного поля,
+// тип — по первым килобайтам файла (одно небольшое чтение на каждый найденный файл).
+UnusedFilesReport build_unused_report(const fs::path& directory, int days_threshold = 30, std::size_t top_k = 100,
+                                      TimeField field = TimeField::Modified, std::size_t top_extensions = 20,
+                                      const ScanMatcher& matcher = ScanMatcher());
+
+// Текстовое представление отчёта (без списка самых больших файлов)
+std::vector<std::string> format_report_summary(const UnusedFilesReport& report);
+
+// Группировка дубликатов по типам: files — число лишних копий, bytes — занимаемое ими место.
+// Размеры берутся из group_info, если он передан, иначе читаются через stat.
+std::vector<TypeStats> summarize_duplicates_by_type(const std::vector<std::vector<fs::path>>& groups,
+                                                    const std::vector<FileType>& group_types,
+                                                    const std::vector<DuplicateGroupInfo>& group_info = {});
+
+// Текстовое представление статистики по типам с заголовком
+std::vector<std::string> format_type_stats(const std::string& title, const std::vector<TypeStats>& types);
+
+#endif // MODULE_REPORT_H
@@ -0,0 +1,390 @@
+#include "module_results_view.h"
+#include <algorithm>
+#include <functional>
+#include <ctime>
+#include <cstdio>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+// Порядок сортировки
+enum class SortMode {
+    None, // В порядке обхода
+    Size, // Сначала самые большие
+    Age   // Сначала самые старые
+};
+
+// Частично отсортированная последовательность: элементы [0, sorted_) уже стоят
+// на своих местах, остальные досортировываются std::partial_sort по мере надобности
+template <typename T>
+class LazySorted {
+public:
+    explicit LazySorted(std::vector<T>& data) : data_(data), sorted_(data.size()) {}
+
+    void set_order(std::function<bool(const T&, const T&)> less) {
+        less_ = std::move(less);
+        sorted_ = less_ ? 0 : data_.size();
+    }
+
+    // Гарантирует, что первые n элементов отсортированы
+    void ensure(std::size_t n) {
+        if (n <= sorted_) {
+            return;
+        }
+        // Досортировываем с запасом, чтобы прокрутка не вызывала сортировку на каждой строке
+        std::size_t target = std::min(data_.size(), std::max({n, sorted_ * 2, static_cast<std::size_t>(256)}));
+        std::partial_sort(data_.begin() + sorted_, data_.begin() + target, data_.end(), less_);
+        sorted_ = target;
+    }
+
+    // Сбрасывает отсортированную часть (например, после заполнения данных)
+    void reset() {
+        sorted_ = less_ ? 0 : data_.size();
+    }
+
+    const T& at(std::size_t i) {
+        ensure(i + 1);
+        return data_[i];
+    }
+
+    std::size_t size() const { return data_.size(); }
+
+private:
+    std::vector<T>& data_;
+    std::size_t sorted_;
+    std::function<bool(const T&, const T&)> less_;
+};
+
+// Группа дубликатов с размером одного файла и временем самого старого из них.
+// Если сведения не пришли вместе с результатами, они читаются через stat
+// только для отрисовываемых групп и для сортировки.
+struct DuplicateGroupView {
+    const std::vector<fs::path>* files;
+    std::uint64_t file_size;
+    std::time_t oldest_mtime;
+    bool known;
+
+    void load() {
+        if (known) {
+            return;
+        }
+        known = true;
+        for (const auto& path : *files) {
+            struct stat st;
+            if (::stat(path.c_str(), &st) == 0) {
+                file_size = static_cast<std::uint64_t>(st.st_size);
+                oldest_mtime = oldest_mtime == 0 ? st.st_mtime : std::min(oldest_mtime, st.st_mtime);
+            }
+        }
+    }
+
+    std::uint64_t wasted() const { return file_size * (files->size() - 1); }
+};
+
+// Разделы просмотра
+enum Section {
+    kSummary = 0,
+    kUnused = 1,
+    kDuplicates = 2,
+    kEmpty = 3,
+    kSectionCount = 4
+};
+
+// Строка, на которую указывает глобальный номер
+struct RowRef {
+    int section;
+    bool header;        // Заголовок раздела
+    std::size_t item;   // Номер элемента (для дубликатов — номер группы)
+    std::size_t member; // Для дубликатов: 0 — заголовок группы, иначе номер файла + 1
+};
+
+// Функция для форматирования размера в удобочитаемом виде
+static std::string format_size(std::uint64_t bytes) {
+    const char* units[] = {"Б", "КБ", "МБ", "ГБ", "ТБ"};
+    double value = static_cast<double>(bytes);
+    int unit = 0;
+    while (value >= 1024 && unit < 4) {
+        value /= 1024;
+        ++unit;
+    }
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), unit == 0 ? "%.0f %s" : "%.1f %s", value, units[unit]);
+    return buffer;
+}
+
+// Функция для обрезки UTF-8 строки до width символов с дополнением пробелами
+static std::string fit_utf8(const std::string& text, int width) {
+    std::string result;
+    int chars = 0;
+    for (std::size_t i = 0; i < text.size() && chars < width; ++chars) {
+        std::size_t len = 1;
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0xF0) len = 4;
+        else if (c >= 0xE0) len = 3;
+        else if (c >= 0xC0) len = 2;
+        result.append(text, i, len);
+        i += len;
+    }
+    result.append(static_cast<std::size_t>(std::max(0, width - chars)), ' ');
+    return result;
+}
+
+class ResultsView {
+public:
+    explicit ResultsView(AnalysisResults& results)
+        : results_(results), unused_(results.unused_files), groups_(group_views_) {
+        for (const auto& file : results_.unused_files) {
+            unused_bytes_ += file.size;
+        }
+        // Размеры групп берутся из результатов; если их нет, потерянное место
+        // подсчитывается только после сортировки по размеру или возрасту
+        const auto& info = results_.duplicate_info;
+        wasted_known_ = info.size() == results_.duplicate_groups.size();
+        group_views_.reserve(results_.duplicate_groups.size());
+        for (std::size_t i = 0; i < results_.duplicate_groups.size(); ++i) {
+            const auto& group = results_.duplicate_groups[i];
+            if (wasted_known_) {
+                group_views_.push_back({&group, info[i].file_size, info[i].oldest_mtime, true});
+                wasted_bytes_ += group_views_.back().wasted();
+            } else {
+                group_views_.push_back({&group, 0, 0, false});
+            }
+            duplicate_rows_ += group.size() + 1;
+        }
+        groups_.reset();
+    }
+
+    void run(WINDOW* win, const std::string& title);
+
+private:
+    std::size_t section_rows(int section) const {
+        if (section == kSummary && results_.summary.empty()) return 0;
+        if (collapsed_[section]) return 1;
+        switch (section) {
+            case kSummary: return 1 + results_.summary.size();
+            case kUnused: return 1 + results_.unused_files.size();
+            case kDuplicates: return 1 + duplicate_rows_;
+            default: return 1 + results_.empty_dirs.size();
+        }
+    }
+
+    std::size_t total_rows() const {
+        return section_rows(kSummary) + section_rows(kUnused) + section_rows(kDuplicates) + section_rows(kEmpty);
+    }
+
+    RowRef resolve(std::size_t row);
+    void locate_duplicate(std::size_t row, RowRef& ref);
+    void draw_row(WINDOW* win, int y, int width, std::size_t row, bool selected);
+    void set_sort(SortMode mode);
+    void load_all_groups();
+
+    AnalysisResults& results_;
+    LazySorted<FileInfo> unused_;
+    std::vector<DuplicateGroupView> group_views_;
+    LazySorted<DuplicateGroupView> groups_;
+    std::vector<std::size_t> group_start_; // Номер первой строки группы (строится по мере прокрутки)
+    std::size_t duplicate_rows_ = 0;
+    std::uint64_t unused_bytes_ = 0;
+    std::uint64_t wasted_bytes_ = 0;
+    bool wasted_known_ = false;
+    bool collapsed_[kSectionCount] = {false, false, false, false};
+    SortMode sort_ = SortMode::None;
+};
+
+// Поиск группы дубликатов, которой принадлежит строка раздела
+void ResultsView::locate_duplicate(std::size_t row, RowRef& ref) {
+    // Префиксные суммы достраиваются только до нужной группы
+    auto group_end = [this](std::size_t g) { return group_start_[g] + groups_.at(g).files->size() + 1; };
+    if (group_start_.empty()) {
+        group_start_.push_back(0);
+    }
+    while (group_end(group_start_.size() - 1) <= row) {
+        group_start_.push_back(group_end(group_start_.size() - 1));
+    }
+    auto it = std::upper_bound(group_start_.begin(), group_start_.end(), row);
+    ref.item = static_cast<std::size_t>(it - group_start_.begin()) - 1;
+    ref.member = row - group_start_[ref.item];
+}
+
+// Определение раздела и элемента по номеру строки
+RowRef ResultsView::resolve(std::size_t row) {
+    RowRef ref{0, false, 0, 0};
+    for (int section = 0; section < kSectionCount; ++section) {
+        std::size_t rows = section_rows(section);
+        if (row < rows) {
+            ref.section = section;
+            ref.header = row == 0;
+            if (!ref.header) {
+                if (section == kDuplicates) {
+                    locate_duplicate(row - 1, ref);
+                } else {
+                    ref.item = row - 1;
+                }
+            }
+            return ref;
+        }
+        row -= rows;
+    }
+    return ref;
+}
+
+// Отрисовка одной строки
+void ResultsView::draw_row(WINDOW* win, int y, int width, std::size_t row, bool selected) {
+    RowRef ref = resolve(row);
+    std::string text;
+    char buffer[512];
+
+    if (ref.header) {
+        const char* mark = collapsed_[ref.section] ? "[+]" : "[-]";
+        if (ref.section == kSummary) {
+            std::snprintf(buffer, sizeof(buffer), "%s Сводка", mark);
+        } else if (ref.section == kUnused) {
+            std::snprintf(buffer, sizeof(buffer), "%s Файлы, не использованные более %d дней: %zu (%s)", mark,
+                          results_.days_threshold, results_.unused_files.size(), format_size(unused_bytes_).c_str());
+        } else if (ref.section == kDuplicates && wasted_known_) {
+            std::snprintf(buffer, sizeof(buffer), "%s Дубликаты файлов: %zu групп, потеряно %s", mark,
+                          results_.duplicate_groups.size(), format_size(wasted_bytes_).c_str());
+        } else if (ref.section == kDuplicates) {
+            std::snprintf(buffer, sizeof(buffer), "%s Дубликаты файлов: %zu групп", mark, results_.duplicate_groups.size());
+        } else {
+            std::snprintf(buffer, sizeof(buffer), "%s Пустые папки: %zu", mark, results_.empty_dirs.size());
+        }
+        text = buffer;
+    } else if (ref.section == kSummary) {
+        text = "  " + results_.summary[ref.item];
+    } else if (ref.section == kUnused) {
+        const FileInfo& file = unused_.at(ref.item);
+        // Дата форматируется только для видимых строк
+        char date[32];
+        std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M", std::localtime(&file.last_used));
+        std::snprintf(buffer, sizeof(buffer), "    %10s  %s  %s", format_size(file.size).c_str(), date, file.path.c_str());
+        text = buffer;
+    } else if (ref.section == kDuplicates) {
+        DuplicateGroupView& group = group_views_[ref.item];
+        groups_.ensure(ref.item + 1);
+        if (ref.member == 0) {
+            group.load();
+            std::snprintf(buffer, sizeof(buffer), "  Группа %zu: %zu файлов по %s, потеряно %s", ref.item + 1,
+                          group.files->size(), format_size(group.file_size).c_str(), format_size(group.wasted()).c_str());
+            text = buffer;
+        } else {
+            text = "    " + (*group.files)[ref.member - 1].string();
+        }
+    } else {
+        text = "    " + results_.empty_dirs[ref.item].string();
+    }
+
+    if (selected) wattron(win, A_REVERSE);
+    mvwprintw(win, y, 1, "%s", fit_utf8(text, width).c_str());
+    if (selected) wattroff(win, A_REVERSE);
+}
+
+// Чтение сведений обо всех группах (нужно для их сортировки, если их нет в результатах)
+void ResultsView::load_all_groups() {
+    if (wasted_known_) {
+        return;
+    }
+    wasted_bytes_ = 0;
+    for (auto& group : group_views_) {
+        group.load();
+        wasted_bytes_ += group.wasted();
+    }
+    wasted_known_ = true;
+}
+
+// Смена порядка сортировки (сама сортировка откладывается до отрисовки)
+void ResultsView::set_sort(SortMode mode) {
+    sort_ = mode;
+    group_start_.clear();
+    if (mode == SortMode::Size) {
+        load_all_groups();
+        unused_.set_order([](const FileInfo& a, const FileInfo& b) { return a.size > b.size; });
+        groups_.set_order([](const DuplicateGroupView& a, const DuplicateGroupView& b) { return a.wasted() > b.wasted(); });
+    } else if (mode == SortMode::Age) {
+        load_all_groups();
+        unused_.set_order([](const FileInfo& a, const FileInfo& b) { return a.last_used < b.last_used; });
+        groups_.set_order([](const DuplicateGroupView& a, const DuplicateGroupView& b) {
+            return a.oldest_mtime < b.oldest_mtime;
+        });
+    }
+}
+
+void ResultsView::run(WINDOW* win, const std::string& title) {
+    std::size_t top = 0;
+    std::size_t cursor = 0;
+
+    while (true) {
+        int height = getmaxy(win) - 4; // Рамка, заголовок и подсказка
+        int width = getmaxx(win) - 2;
+        std::size_t total = total_rows();
+        if (cursor >= total) cursor = total - 1;
+        if (cursor < top) top = cursor;
+        if (cursor >= top + height) top = cursor - height + 1;
+
+        werase(win);
+        box(win, 0, 0);
+        const char* sort_name = sort_ == SortMode::Size ? "по размеру" : sort_ == SortMode::Age ? "по возрасту" : "по обходу";
+        mvwprintw(win, 1, 1, "%s (строк: %zu, сортировка %s)", title.c_str(), total, sort_name);
+        for (int i = 0; i < height && top + i < total; ++i) {
+            draw_row(win, 2 + i, width, top + i, top + i == cursor);
+        }
+        mvwprintw(win, getmaxy(win) - 2, 1, "↑/↓/PgUp/PgDn: Прокрутка | Enter: Свернуть | Tab: Раздел | s/a: Сортировка | q: Назад");
+        wrefresh(win);
+
+        int ch = wgetch(win);
+        switch (ch) {
+            case KEY_UP:
+                if (cursor > 0) cursor--;
+                break;
+            case KEY_DOWN:
+                if (cursor + 1 < total) cursor++;
+                break;
+            case KEY_PPAGE:
+                cursor = cursor > static_cast<std::size_t>(height) ? cursor - height : 0;
+                break;
+            case KEY_NPAGE:
+                cursor = std::min(total - 1, cursor + height);
+                break;
+            case KEY_HOME:
+                cursor = 0;
+                break;
+            case KEY_END:
+                cursor = total - 1;
+                break;
+            case '\t':
+                {
+                    // Переход к заголовку следующего раздела
+                    RowRef ref = resolve(cursor);
+                    std::size_t start = 0;
+                    for (int s = 0; s <= ref.section; ++s) start += section_rows(s);
+                    cursor = start < total ? start : 0;
+                }
+                break;
+            case '\n':
+            case ' ':
+                {
+                    RowRef ref = resolve(cursor);
+                    if (ref.header) {
+                        collapsed_[ref.section] = !collapsed_[ref.section];
+                    }
+                }
+                break;
+            case 's':
+                set_sort(SortMode::Size);
+                break;
+            case 'a':
+                set_sort(SortMode::Age);
+                break;
+            case 'q':
+            case 'Q':
+            case 27: // Esc
+                return;
+        }
+    }
+}
+
+// Просмотр результатов анализа
+void show_results_view(WINDOW* win, const std::string& title, AnalysisResults& results) {
+    ResultsView view(results);
+    view.run(win, title);
+}
@@ -0,0 +1,27 @@
+#ifndef MODULE_RESULTS_VIEW_H
+#define MODULE_RESULTS_VIEW_H
+
+#include <ncursesw/ncurses.h>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include "module_analization.h"
+
+namespace fs = std::filesystem;
+
+// Результаты анализа для просмотра
+struct AnalysisResults {
+    std::vector<std::string> summary; // Строки сводки (раздел скрыт, если пусто)
+    int days_threshold = 30;
+    std::vector<FileInfo> unused_files;
+    std::vector<std::vector<fs::path>> duplicate_groups;
+    std::vector<DuplicateGroupInfo> duplicate_info; // Размеры и возраст групп (если пусто — читаются при отрисовке)
+    std::vector<fs::path> empty_dirs;
+};
+
+// Просмотр результатов с прокруткой: отрисовываются только видимые строки,
+// разделы сворачиваются, сортировка по размеру или возрасту выполняется
+// частично — ровно настолько, насколько пользователь пролистал список.
+void show_results_view(WINDOW* win, const std::string& title, AnalysisResults& results);
+
+#endif // MODULE_RESULTS_VIEW_H
@@ -0,0 +1,233 @@
+#include "module_scan_rules.h"
+#include <algorithm>
+#include <sstream>
+#include <chrono>
+#include <cctype>
+#include <limits>
+#include <fnmatch.h>
+
+namespace fs = std::filesystem;
+
+// Функция для разбора размера с суффиксом (K, M, G)
+static bool parse_size(const std::string& text, std::uintmax_t& size) {
+    // stoull принимает и "-1", возвращая его по модулю 2^64, поэтому знак не допускается
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    std::size_t pos = 0;
+    unsigned long long value = 0;
+    try {
+        value = std::stoull(text, &pos);
+    } catch (const std::exception&) {
+        return false;
+    }
+    std::string suffix = text.substr(pos);
+    unsigned shift = 0;
+    if (suffix == "K" || suffix == "k") shift = 10;
+    else if (suffix == "M" || suffix == "m") shift = 20;
+    else if (suffix == "G" || suffix == "g") shift = 30;
+    else if (!suffix.empty()) return false;
+    // Размер, не помещающийся в 64 бита после умножения на суффикс, — ошибка, а не усечённое значение
+    if (value > (std::numeric_limits<std::uintmax_t>::max() >> shift)) {
+        return false;
+    }
+    size = value << shift;
+    return true;
+}
+
+// Функция для разбора списка шаблонов через запятую
+static void split_patterns(const std::string& text, std::vector<std::string>& patterns) {
+    std::stringstream stream(text);
+    std::string pattern;
+    while (std::getline(stream, pattern, ',')) {
+        if (!pattern.empty()) {
+            patterns.push_back(pattern);
+        }
+    }
+}
+
+// Разбор правил из строки
+bool parse_scan_rules(const std::string& spec, ScanRules& rules, std::string& error) {
+    std::string normalized = spec;
+    for (char& c : normalized) {
+        if (c == ';') c = ' ';
+    }
+
+    std::stringstream stream(normalized);
+    std::string token;
+    while (stream >> token) {
+        std::string key = token;
+        std::string value;
+        auto eq = token.find('=');
+        if (eq != std::string::npos) {
+            key = token.substr(0, eq);
+            value = token.substr(eq + 1);
+        }
+
+        if (key == "exclude") {
+            split_patterns(value, rules.exclude);
+        } else if (key == "include") {
+            split_patterns(value, rules.include);
+        } else if (key == "min-size" || key == "max-size") {
+            std::uintmax_t size = 0;
+            if (!parse_size(value, size)) {
+                error = "Неверный размер: " + token;
+                return false;
+            }
+            (key == "min-size" ? rules.min_size : rules.max_size) = size;
+        } else if (key == "min-age" || key == "max-age") {
+            try {
+                (key == "min-age" ? rules.min_age_days : rules.max_age_days) = std::stoi(value);
+            } catch (const std::exception&) {
+                error = "Неверный возраст: " + token;
+                return false;
+            }
+        } else if (key == "type") {
+            std::vector<std::string> names;
+            split_patterns(value, names);
+            for (const auto& name : names) {
+                FileType type;
+                if (!parse_file_type(name, type)) {
+                    error = "Неизвестный тип файла: " + name;
+                    return false;
+                }
+                rules.types.push_back(type);
+            }
+        } else if (key == "xdev") {
+            rules.one_file_system = true;
+        } else if (key == "follow-symlinks") {
+            rules.follow_symlinks = true;
+        } else {
+            error = "Неизвестное правило: " + token;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Функция для проверки, содержит ли шаблон спецсимволы glob
+static bool has_wildcards(const std::string& pattern) {
+    return pattern.find_first_of("*?[") != std::string::npos;
+}
+
+ScanMatcher::ScanMatcher(const ScanRules& rules)
+    : min_size_(rules.min_size),
+      max_size_(rules.max_size),
+      min_age_days_(rules.min_age_days),
+      max_age_days_(rules.max_age_days),
+      one_file_system_(rules.one_file_system),
+      follow_symlinks_(rules.follow_symlinks) {
+    for (const auto& pattern : rules.exclude) {
+        bool whole_path = pattern.find('/') != std::string::npos;
+        if (!whole_path && !has_wildcards(pattern)) {
+            exclude_names_.insert(pattern);
+        } else {
+            exclude_globs_.push_back({pattern, whole_path});
+        }
+    }
+    for (const auto& pattern : rules.include) {
+        bool whole_path = pattern.find('/') != std::string::npos;
+        if (!whole_path && !has_wildcards(pattern)) {
+            include_names_.insert(pattern);
+        } else {
+            include_globs_.push_back({pattern, whole_path});
+        }
+    }
+    for (FileType type : rules.types) {
+        type_mask_ |= 1u << static_cast<unsigned>(type);
+    }
+    empty_ = rules.exclude.empty() && rules.include.empty() && min_size_ == 0 &&
+             max_size_ == UINTMAX_MAX && min_age_days_ < 0 && max_age_days_ < 0;
+
+    // Порядок шаблонов на обход не влияет, поэтому в описании они упорядочены
+    std::vector<std::string> exclude = rules.exclude;
+    std::sort(exclude.begin(), exclude.end());
+    walk_spec_ = "exclude=";
+    for (std::size_t i = 0; i < exclude.size(); ++i) {
+        walk_spec_ += (i ? "," : "") + exclude[i];
+    }
+    if (one_file_system_) {
+        walk_spec_ += " xdev";
+    }
+}
+
+bool ScanMatcher::matches(const std::vector<Pattern>& patterns, const fs::path& path) {
+    if (patterns.empty()) {
+        return false;
+    }
+    const std::string name = path.filename().string();
+    const std::string full = path.string();
+    for (const auto& pattern : patterns) {
+        const std::string& subject = pattern.whole_path ? full : name;
+        if (fnmatch(pattern.glob.c_str(), subject.c_str(), 0) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ScanMatcher::prune_directory(const fs::path& dir_path) const {
+    return exclude_names_.count(dir_path.filename().string()) > 0 || matches(exclude_globs_, dir_path);
+}
+
+// Проверка имени файла по шаблонам исключения и включения
+bool ScanMatcher::name_allowed(const fs::path& path) const {
+    if (exclude_names_.count(path.filename().string()) > 0 || matches(exclude_globs_, path)) {
+        return false;
+    }
+    if ((!include_names_.empty() || !include_globs_.empty()) &&
+        include_names_.count(path.filename().string()) == 0 && !matches(include_globs_, path)) {
+        return false;
+    }
+    return true;
+}
+
+bool ScanMatcher::accept_file(const fs::directory_entry& entry) const {
+    if (empty_) {
+        return true;
+    }
+    if (!name_allowed(entry.path())) {
+        return false;
+    }
+
+    std::error_code ec;
+    if (min_size_ > 0 || max_size_ != UINTMAX_MAX) {
+        auto size = entry.file_size(ec);
+        if (ec || size < min_size_ || size > max_size_) {
+            return false;
+        }
+    }
+    if (min_age_days_ >= 0 || max_age_days_ >= 0) {
+        auto write_time = entry.last_write_time(ec);
+        if (ec) {
+            return false;
+        }
+        auto age_days = std::chrono::duration_cast<std::chrono::hours>(
+                            fs::file_time_type::clock::now() - write_time).count() / 24;
+        if ((min_age_days_ >= 0 && age_days < min_age_days_) ||
+            (max_age_days_ >= 0 && age_days > max_age_days_)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ScanMatcher::accept_file(const fs::path& path, std::uintmax_t size, std::time_t mtime) const {
+    if (empty_) {
+        return true;
+    }
+    if (!name_allowed(path)) {
+        return false;
+    }
+    if (size < min_size_ || size > max_size_) {
+        return false;
+    }
+    if (min_age_days_ >= 0 || max_age_days_ >= 0) {
+        long long age_days = (std::time(nullptr) - mtime) / (24 * 60 * 60);
+        if ((min_age_days_ >= 0 && age_days < min_age_days_) ||
+            (max_age_days_ >= 0 && age_days > max_age_days_)) {
+            return false;
+        }
+    }
+    return true;
+}
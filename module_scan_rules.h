@@ -0,0 +1,85 @@
+#ifndef MODULE_SCAN_RULES_H
+#define MODULE_SCAN_RULES_H
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <filesystem>
+#include <cstdint>
+#include <ctime>
+#include "module_file_types.h"
+
+namespace fs = std::filesystem;
+
+// Правила отбора файлов и папок при сканировании
+struct ScanRules {
+    std::vector<std::string> exclude;  // Шаблоны исключаемых файлов и папок (папки отсекаются целиком)
+    std::vector<std::string> include;  // Если не пусто — учитываются только совпадающие файлы
+    std::uintmax_t min_size = 0;
+    std::uintmax_t max_size = UINTMAX_MAX;
+    int min_age_days = -1;             // -1 — ограничение не задано
+    int max_age_days = -1;
+    bool one_file_system = false;      // Не переходить на другие файловые системы
+    bool follow_symlinks = false;      // Переходить по символическим ссылкам
+    std::vector<FileType> types;       // Если не пусто — учитываются только файлы этих типов
+};
+
+// Разбор правил из строки вида "exclude=.git,node_modules min-size=1M type=image,video xdev".
+// Один и тот же формат используется в интерфейсе и в командной строке.
+bool parse_scan_rules(const std::string& spec, ScanRules& rules, std::string& error);
+
+// Правила, один раз скомпилированные для быстрой проверки при обходе
+class ScanMatcher {
+public:
+    explicit ScanMatcher(const ScanRules& rules = ScanRules());
+
+    // Нужно ли отсечь папку вместе со всем её поддеревом
+    bool prune_directory(const fs::path& dir_path) const;
+
+    // Учитывать ли файл в результатах анализа
+    bool accept_file(const fs::directory_entry& entry) const;
+
+    // То же по уже известным размеру и времени изменения (без обращения к диску)
+    bool accept_file(const fs::path& path, std::uintmax_t size, std::time_t mtime) const;
+
+    // Задан ли отбор по типу содержимого (для проверки нужно прочитать начало файла)
+    bool filters_types() const { return type_mask_ != 0; }
+
+    // Учитывать ли файл с уже определённым типом
+    bool accept_type(FileType type) const {
+        return type_mask_ == 0 || (type_mask_ & (1u << static_cast<unsigned>(type))) != 0;
+    }
+
+    bool one_file_system() const { return one_file_system_; }
+    bool follow_symlinks() const { return follow_symlinks_; }
+    bool empty() const { return empty_; }
+
+    // Правила, от которых зависит состав обойдённого дерева (исключения и xdev), в виде
+    // строки: сохранённые результаты обхода пригодны только для тех же правил
+    const std::string& walk_spec() const { return walk_spec_; }
+
+private:
+    struct Pattern {
+        std::string glob;
+        bool whole_path; // Шаблон с '/' сравнивается с полным путём, иначе — с именем
+    };
+
+    static bool matches(const std::vector<Pattern>& patterns, const fs::path& path);
+    bool name_allowed(const fs::path& path) const;
+
+    std::unordered_set<std::string> exclude_names_; // Шаблоны без спецсимволов — проверка за O(1)
+    std::vector<Pattern> exclude_globs_;
+    std::unordered_set<std::string> include_names_;
+    std::vector<Pattern> include_globs_;
+    std::uintmax_t min_size_;
+    std::uintmax_t max_size_;
+    int min_age_days_;
+    int max_age_days_;
+    bool one_file_system_;
+    bool follow_symlinks_;
+    std::uint32_t type_mask_ = 0; // Бит на каждый допустимый тип
+    bool empty_;
+    std::string walk_spec_;
+};
+
+#endif // MODULE_SCAN_RULES_H
@@ -0,0 +1,862 @@
+#include "module_snapshot.h"
+#include "module_io_policy.h"
+#include "module_read_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <unordered_map>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+// Сигнатура и версия формата снимка
+static const char kSnapshotMagic[8] = {'A', 'N', 'S', 'N', 'A', 'P', '0', '2'};
+
+// Сигнатура контрольной точки (правила обхода, время записи и снимок в том же формате)
+static const char kCheckpointMagic[8] = {'A', 'N', 'C', 'K', 'P', 'T', '0', '2'};
+
+// Контрольная точка старше этого срока не используется: дерево успело сильно измениться
+static const std::int64_t kCheckpointMaxAgeNs = 24LL * 3600 * 1000000000LL;
+
+// Минимальный интервал между контрольными точками
+static const std::chrono::seconds kCheckpointInterval(30);
+
+// Папка, изменённая меньше чем за секунду до начала прошлого сканирования,
+// могла измениться ещё раз с тем же временем — такие папки перечитываются
+static const std::int64_t kRacyWindowNs = 1000000000LL;
+
+static std::int64_t to_ns(const struct timespec& ts) {
+    return static_cast<std::int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// ---- Двоичная запись и чтение ----
+
+template <typename T>
+static void write_value(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void write_string(std::ofstream& out, const std::string& text) {
+    write_value(out, static_cast<std::uint32_t>(text.size()));
+    out.write(text.data(), text.size());
+}
+
+template <typename T>
+static bool read_value(std::ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+// Длина строки и число элементов в файле не проверены: память под них выделяется
+// порциями по мере чтения, чтобы повреждённый счётчик не приводил к bad_alloc
+static const std::size_t kReadChunk = 64 * 1024;
+
+static bool read_string(std::ifstream& in, std::string& text) {
+    std::uint32_t length = 0;
+    if (!read_value(in, length)) {
+        return false;
+    }
+    text.clear();
+    while (text.size() < length) {
+        std::size_t offset = text.size();
+        text.resize(offset + std::min<std::size_t>(length - offset, kReadChunk));
+        if (!in.read(&text[offset], static_cast<std::streamsize>(text.size() - offset))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Флаги элемента в снимке. Старые снимки хранили здесь только признак хэша,
+// а тип тогда определялся только вместе с ним, поэтому формат остаётся совместимым.
+static const std::uint8_t kEntryHasHash = 1;
+static const std::uint8_t kEntryHasType = 2;
+
+// Запись снимка (без сигнатуры) в поток
+static void write_snapshot_body(std::ofstream& out, const ScanSnapshot& snapshot) {
+    write_string(out, snapshot.root);
+    write_value(out, snapshot.scan_time_ns);
+    write_value(out, static_cast<std::uint64_t>(snapshot.directories.size()));
+    for (const auto& [rel_path, dir] : snapshot.directories) {
+        write_string(out, rel_path);
+        write_value(out, dir.mtime_ns);
+        write_value(out, static_cast<std::uint32_t>(dir.entries.size()));
+        for (const auto& entry : dir.entries) {
+            write_string(out, entry.name);
+            write_value(out, static_cast<std::uint8_t>(entry.type));
+            write_value(out, static_cast<std::uint8_t>((entry.has_hash ? kEntryHasHash : 0) |
+                                                       (entry.has_type ? kEntryHasType : 0)));
+            write_value(out, static_cast<std::uint8_t>(entry.file_type));
+            write_value(out, entry.size);
+            write_value(out, entry.mtime_ns);
+            write_value(out, entry.hash);
+        }
+    }
+}
+
+// Чтение снимка (после сигнатуры) из потока
+static bool read_snapshot_body(std::ifstream& in, ScanSnapshot& loaded) {
+    std::uint64_t dir_count = 0;
+    if (!read_string(in, loaded.root) || !read_value(in, loaded.scan_time_ns) || !read_value(in, dir_count)) {
+        return false;
+    }
+    for (std::uint64_t i = 0; i < dir_count; ++i) {
+        std::string rel_path;
+        SnapshotDirectory dir;
+        std::uint32_t entry_count = 0;
+        if (!read_string(in, rel_path) || !read_value(in, dir.mtime_ns) || !read_value(in, entry_count)) {
+            return false;
+        }
+        dir.entries.reserve(std::min<std::size_t>(entry_count, kReadChunk));
+        for (std::uint32_t k = 0; k < entry_count; ++k) {
+            SnapshotEntry& entry = dir.entries.emplace_back();
+            std::uint8_t type = 0;
+            std::uint8_t flags = 0;
+            std::uint8_t file_type = 0;
+            if (!read_string(in, entry.name) || !read_value(in, type) || !read_value(in, flags) ||
+                !read_value(in, file_type) || file_type >= kFileTypeCount ||
+                !read_value(in, entry.size) || !read_value(in, entry.mtime_ns) || !read_value(in, entry.hash)) {
+                return false;
+            }
+            entry.type = static_cast<EntryType>(type);
+            entry.has_hash = (flags & kEntryHasHash) != 0;
+            entry.has_type = (flags & (kEntryHasHash | kEntryHasType)) != 0;
+            entry.file_type = static_cast<FileType>(file_type);
+        }
+        loaded.directories.emplace(std::move(rel_path), std::move(dir));
+    }
+    return true;
+}
+
+// Сохранение снимка
+bool save_snapshot(const ScanSnapshot& snapshot, const fs::path& file_path) {
+    std::error_code ec;
+    fs::create_directories(file_path.parent_path(), ec);
+    fs::path tmp_path = file_path.string() + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out.write(kSnapshotMagic, sizeof(kSnapshotMagic));
+        write_snapshot_body(out, snapshot);
+        if (!out) {
+            return false;
+        }
+    }
+    fs::rename(tmp_path, file_path, ec);
+    return !ec;
+}
+
+// Загрузка снимка
+bool load_snapshot(const fs::path& file_path, ScanSnapshot& snapshot) {
+    std::ifstream in(file_path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    char magic[sizeof(kSnapshotMagic)];
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kSnapshotMagic, sizeof(magic)) != 0) {
+        return false;
+    }
+    ScanSnapshot loaded;
+    if (!read_snapshot_body(in, loaded)) {
+        return false;
+    }
+    snapshot = std::move(loaded);
+    return true;
+}
+
+// Текущее время в наносекундах
+static std::int64_t now_ns() {
+    struct timespec now;
+    ::clock_gettime(CLOCK_REALTIME, &now);
+    return to_ns(now);
+}
+
+// Сохранение контрольной точки: правила обхода, время записи и снимок
+static bool save_checkpoint(const fs::path& file_path, const std::string& walk_spec, const ScanSnapshot& snapshot) {
+    std::error_code ec;
+    fs::create_directories(file_path.parent_path(), ec);
+    fs::path tmp_path = file_path.string() + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out.write(kCheckpointMagic, sizeof(kCheckpointMagic));
+        write_string(out, walk_spec);
+        write_value(out, now_ns());
+        write_snapshot_body(out, snapshot);
+        out.flush();
+        if (!out) {
+            return false;
+        }
+    }
+    fs::rename(tmp_path, file_path, ec); // Старая точка заменяется только целиком записанной новой
+    return !ec;
+}
+
+// Загрузка контрольной точки. Точка, записанная при других правилах обхода или
+// слишком давно, отбрасывается.
+static bool load_checkpoint(const fs::path& file_path, const std::string& walk_spec, ScanSnapshot& snapshot) {
+    std::ifstream in(file_path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    char magic[sizeof(kCheckpointMagic)];
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kCheckpointMagic, sizeof(magic)) != 0) {
+        return false;
+    }
+    std::string saved_spec;
+    std::int64_t saved_at = 0;
+    if (!read_string(in, saved_spec) || saved_spec != walk_spec || !read_value(in, saved_at)) {
+        return false;
+    }
+    std::int64_t age = now_ns() - saved_at;
+    if (age < 0 || age > kCheckpointMaxAgeNs) {
+        return false;
+    }
+    ScanSnapshot loaded;
+    if (!read_snapshot_body(in, loaded)) {
+        return false;
+    }
+    snapshot = std::move(loaded);
+    return true;
+}
+
+// Периодическая запись контрольных точек. Интервал растёт, если запись занимает
+// заметное время, чтобы на больших деревьях она не отнимала больше ~10% работы.
+class CheckpointWriter {
+public:
+    CheckpointWriter(const fs::path& file_path, const std::string& walk_spec)
+        : file_path_(file_path), walk_spec_(walk_spec), last_(std::chrono::steady_clock::now()) {}
+
+    void maybe_save(const ScanSnapshot& snapshot) {
+        auto now = std::chrono::steady_clock::now();
+        if (file_path_.empty() || now - last_ < interval_) {
+            return;
+        }
+        save_checkpoint(file_path_, walk_spec_, snapshot);
+        last_ = std::chrono::steady_clock::now();
+        interval_ = std::max<std::chrono::steady_clock::duration>(kCheckpointInterval, (last_ - now) * 10);
+    }
+
+    void save(const ScanSnapshot& snapshot) {
+        if (!file_path_.empty()) {
+            save_checkpoint(file_path_, walk_spec_, snapshot);
+            last_ = std::chrono::steady_clock::now();
+        }
+    }
+
+private:
+    fs::path file_path_;
+    std::string walk_spec_;
+    std::chrono::steady_clock::time_point last_;
+    std::chrono::steady_clock::duration interval_ = kCheckpointInterval;
+};
+
+// Путь к снимку для папки
+fs::path default_snapshot_path(const fs::path& root) {
+    fs::path cache_dir;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        cache_dir = xdg;
+    } else if (const char* home = std::getenv("HOME")) {
+        cache_dir = fs::path(home) / ".cache";
+    } else {
+        cache_dir = fs::temp_directory_path();
+    }
+    std::error_code ec;
+    std::string key = fs::weakly_canonical(root, ec).string();
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016zx.snap", std::hash<std::string>{}(key));
+    return cache_dir / "analizator" / name;
+}
+
+// Путь к контрольной точке для папки
+fs::path default_checkpoint_path(const fs::path& root) {
+    return default_snapshot_path(root).string() + ".ckpt";
+}
+
+// Функция для соединения относительного пути папки и имени элемента
+static std::string join_relative(const std::string& dir, const std::string& name) {
+    return dir.empty() ? name : dir + "/" + name;
+}
+
+// Чтение содержимого папки с вызовом stat для каждого элемента
+static bool read_directory_entries(const fs::path& dir_path, const SnapshotDirectory* previous,
+                                   std::vector<SnapshotEntry>& entries, RescanStats* stats) {
+    throttle_io(0);
+    DIR* stream = ::opendir(dir_path.c_str());
+    if (!stream) {
+        record_scan_error(dir_path, std::strerror(errno));
+        return false;
+    }
+    int dir_fd = ::dirfd(stream);
+    while (dirent* item = ::readdir(stream)) {
+        if (std::strcmp(item->d_name, ".") == 0 || std::strcmp(item->d_name, "..") == 0) {
+            continue;
+        }
+        struct stat st;
+        if (::fstatat(dir_fd, item->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue; // Элемент удалён во время чтения
+        }
+        if (stats) {
+            stats->entries_stated++;
+        }
+        SnapshotEntry entry;
+        entry.name = item->d_name;
+        entry.type = S_ISREG(st.st_mode) ? EntryType::File
+                   : S_ISDIR(st.st_mode) ? EntryType::Directory : EntryType::Other;
+        entry.size = static_cast<std::uint64_t>(st.st_size);
+        entry.mtime_ns = to_ns(st.st_mtim);
+        entry.hash = 0;
+        entry.has_hash = false;
+        entry.has_type = false;
+        entry.file_type = FileType::Unknown;
+        entries.push_back(std::move(entry));
+    }
+    ::closedir(stream);
+
+    std::sort(entries.begin(), entries.end(),
+              [](const SnapshotEntry& a, const SnapshotEntry& b) { return a.name < b.name; });
+
+    // Хэши и типы переносятся из прошлого снимка для файлов с теми же размером и временем
+    if (previous) {
+        auto prev = previous->entries.begin();
+        for (auto& entry : entries) {
+            while (prev != previous->entries.end() && prev->name < entry.name) ++prev;
+            if (prev != previous->entries.end() && prev->name == entry.name &&
+                prev->type == entry.type && prev->size == entry.size && prev->mtime_ns == entry.mtime_ns) {
+                entry.hash = prev->hash;
+                entry.has_hash = prev->has_hash;
+                entry.has_type = prev->has_type;
+                entry.file_type = prev->file_type;
+            }
+        }
+    }
+    return true;
+}
+
+// Обновление размера и времени элемента по свежему stat; хэш сбрасывается, если файл изменился
+static void update_entry(SnapshotEntry& entry, const struct stat& st) {
+    EntryType type = S_ISREG(st.st_mode) ? EntryType::File
+                   : S_ISDIR(st.st_mode) ? EntryType::Directory : EntryType::Other;
+    std::uint64_t size = static_cast<std::uint64_t>(st.st_size);
+    std::int64_t mtime_ns = to_ns(st.st_mtim);
+    if (entry.type != type || entry.size != size || entry.mtime_ns != mtime_ns) {
+        entry.type = type;
+        entry.size = size;
+        entry.mtime_ns = mtime_ns;
+        entry.hash = 0;
+        entry.has_hash = false;
+        entry.has_type = false;
+        entry.file_type = FileType::Unknown;
+    }
+}
+
+// Повторный stat элементов папки, список которой взят из снимка
+static bool restat_directory_entries(const fs::path& dir_path, std::vector<SnapshotEntry>& entries, RescanStats* stats) {
+    int dir_fd = ::open(dir_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) {
+        record_scan_error(dir_path, std::strerror(errno));
+        return false;
+    }
+    auto gone = std::remove_if(entries.begin(), entries.end(), [&](SnapshotEntry& entry) {
+        struct stat st;
+        if (::fstatat(dir_fd, entry.name.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            return true; // Элемент удалён после проверки времени папки
+        }
+        if (stats) {
+            stats->entries_stated++;
+        }
+        update_entry(entry, st);
+        return false;
+    });
+    entries.erase(gone, entries.end());
+    ::close(dir_fd);
+    return true;
+}
+
+// Инкрементальное сканирование
+ScanSnapshot scan_incremental(const fs::path& root, const ScanSnapshot* previous,
+                              const ScanMatcher& matcher, RescanStats* stats, const fs::path& checkpoint_path,
+                              SnapshotReuse reuse) {
+    ScanSnapshot snapshot;
+    snapshot.root = root.string();
+    snapshot.scan_time_ns = now_ns();
+
+    if (previous && previous->root != snapshot.root) {
+        previous = nullptr;
+    }
+
+    struct stat root_st;
+    if (::stat(root.c_str(), &root_st) != 0) {
+        record_scan_error(root, std::strerror(errno));
+        return snapshot;
+    }
+
+    // Прерванный обход начинается заново от корня, но папки, прочитанные до прерывания,
+    // проверяются по времени изменения, как при обычном инкрементальном сканировании:
+    // неизменившиеся берутся из контрольной точки, изменившиеся перечитываются
+    ScanSnapshot resumed;
+    bool has_resumed = !checkpoint_path.empty() && load_checkpoint(checkpoint_path, matcher.walk_spec(), resumed) &&
+                       resumed.root == snapshot.root;
+    if (has_resumed && stats) {
+        stats->resumed = true;
+    }
+    CheckpointWriter checkpoint(checkpoint_path, matcher.walk_spec());
+
+    std::vector<std::string> pending = {""};
+    while (!pending.empty()) {
+        checkpoint.maybe_save(snapshot);
+        std::string rel_path = std::move(pending.back());
+        pending.pop_back();
+        fs::path full_path = rel_path.empty() ? root : root / rel_path;
+
+        struct stat st;
+        if (::stat(full_path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            continue; // Папка удалена во время обхода
+        }
+        if (matcher.one_file_system() && st.st_dev != root_st.st_dev) {
+            continue;
+        }
+
+        SnapshotDirectory dir;
+        dir.mtime_ns = to_ns(st.st_mtim);
+
+        // Контрольная точка новее прошлого снимка, поэтому проверяется первой
+        const ScanSnapshot* source = nullptr;
+        const SnapshotDirectory* prev_dir = nullptr;
+        const ScanSnapshot* candidates[] = {has_resumed ? &resumed : nullptr, previous};
+        for (const ScanSnapshot* candidate : candidates) {
+            if (!candidate || prev_dir) {
+                continue;
+            }
+            auto it = candidate->directories.find(rel_path);
+            if (it != candidate->directories.end()) {
+                source = candidate;
+                prev_dir = &it->second;
+            }
+        }
+
+        if (prev_dir && prev_dir->mtime_ns == dir.mtime_ns &&
+            dir.mtime_ns < source->scan_time_ns - kRacyWindowNs) {
+            dir.entries = prev_dir->entries; // Папка не менялась — содержимое из снимка
+            if (reuse == SnapshotReuse::Names && !restat_directory_entries(full_path, dir.entries, stats)) {
+                continue;
+            }
+        } else {
+            if (!read_directory_entries(full_path, prev_dir, dir.entries, stats)) {
+                continue;
+            }
+            if (stats) {
+                stats->directories_reread++;
+            }
+        }
+        if (stats) {
+            stats->directories_total++;
+        }
+
+        for (const auto& entry : dir.entries) {
+            if (entry.type == EntryType::Directory && !matcher.prune_directory(full_path / entry.name)) {
+                pending.push_back(join_relative(rel_path, entry.name));
+            }
+        }
+        snapshot.directories.emplace(std::move(rel_path), std::move(dir));
+    }
+    checkpoint.save(snapshot); // Обход завершён: дальше продолжится только хэширование
+    return snapshot;
+}
+
+// Удаление папки и всего её поддерева из снимка
+static void remove_subtree(ScanSnapshot& snapshot, const std::string& rel_path, std::vector<std::string>* removed) {
+    if (snapshot.directories.erase(rel_path) && removed) {
+        removed->push_back(rel_path);
+    }
+    // Вложенные папки идут в map подряд сразу за префиксом "путь/"
+    const std::string prefix = rel_path.empty() ? rel_path : rel_path + "/";
+    auto it = snapshot.directories.lower_bound(prefix);
+    while (it != snapshot.directories.end() && it->first.compare(0, prefix.size(), prefix) == 0) {
+        if (removed) {
+            removed->push_back(it->first);
+        }
+        it = snapshot.directories.erase(it);
+    }
+}
+
+// Перечитывание отдельных папок снимка
+void refresh_directories(ScanSnapshot& snapshot, const std::vector<std::string>& rel_paths, const ScanMatcher& matcher,
+                         std::vector<std::string>* added, std::vector<std::string>* removed) {
+    const fs::path root = snapshot.root;
+    struct stat root_st;
+    if (::stat(root.c_str(), &root_st) != 0) {
+        remove_subtree(snapshot, "", removed); // Корень удалён
+        return;
+    }
+
+    std::vector<std::string> pending(rel_paths.begin(), rel_paths.end());
+    while (!pending.empty()) {
+        std::string rel_path = std::move(pending.back());
+        pending.pop_back();
+        fs::path full_path = rel_path.empty() ? root : root / rel_path;
+
+        struct stat st;
+        if (::stat(full_path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) ||
+            (matcher.one_file_system() && st.st_dev != root_st.st_dev)) {
+            remove_subtree(snapshot, rel_path, removed);
+            continue;
+        }
+
+        auto it = snapshot.directories.find(rel_path);
+        const SnapshotDirectory* prev_dir = it != snapshot.directories.end() ? &it->second : nullptr;
+        SnapshotDirectory dir;
+        dir.mtime_ns = to_ns(st.st_mtim);
+        if (!read_directory_entries(full_path, prev_dir, dir.entries, nullptr)) {
+            remove_subtree(snapshot, rel_path, removed);
+            continue;
+        }
+
+        // Исчезнувшие вложенные папки удаляются, новые читаются целиком
+        if (prev_dir) {
+            for (const auto& entry : prev_dir->entries) {
+                if (entry.type != EntryType::Directory) {
+                    continue;
+                }
+                auto same = std::lower_bound(dir.entries.begin(), dir.entries.end(), entry.name,
+                                             [](const SnapshotEntry& e, const std::string& name) { return e.name < name; });
+                if (same == dir.entries.end() || same->name != entry.name || same->type != EntryType::Directory) {
+                    remove_subtree(snapshot, join_relative(rel_path, entry.name), removed);
+                }
+            }
+        } else if (added) {
+            added->push_back(rel_path);
+        }
+        for (const auto& entry : dir.entries) {
+            std::string child = join_relative(rel_path, entry.name);
+            if (entry.type == EntryType::Directory && !snapshot.directories.count(child) &&
+                !matcher.prune_directory(full_path / entry.name)) {
+                pending.push_back(std::move(child));
+            }
+        }
+        snapshot.directories[rel_path] = std::move(dir);
+    }
+}
+
+// Отметка всех элементов папки (и вложенных папок) как добавленных или удалённых
+static void report_directory(const ScanSnapshot& snapshot, const std::string& rel_path, ChangeKind kind,
+                             std::vector<SnapshotChange>& changes) {
+    auto it = snapshot.directories.find(rel_path);
+    if (it == snapshot.directories.end()) {
+        return;
+    }
+    for (const auto& entry : it->second.entries) {
+        changes.push_back({kind, join_relative(rel_path, entry.name), entry.type});
+    }
+}
+
+// Изменения между двумя снимками
+std::vector<SnapshotChange> diff_snapshots(const ScanSnapshot& before, const ScanSnapshot& after) {
+    std::vector<SnapshotChange> changes;
+    auto old_it = before.directories.begin();
+    auto new_it = after.directories.begin();
+
+    while (old_it != before.directories.end() || new_it != after.directories.end()) {
+        if (new_it == after.directories.end() ||
+            (old_it != before.directories.end() && old_it->first < new_it->first)) {
+            // Папка исчезла: её элементы удалены (сама папка — элемент родителя)
+            report_directory(before, old_it->first, ChangeKind::Removed, changes);
+            ++old_it;
+            continue;
+        }
+        if (old_it == before.directories.end() || new_it->first < old_it->first) {
+            report_directory(after, new_it->first, ChangeKind::Added, changes);
+            ++new_it;
+            continue;
+        }
+
+        // Папка есть в обоих снимках: сравниваем отсортированные списки элементов
+        const auto& old_entries = old_it->second.entries;
+        const auto& new_entries = new_it->second.entries;
+        std::size_t i = 0, j = 0;
+        while (i < old_entries.size() || j < new_entries.size()) {
+            if (j == new_entries.size() || (i < old_entries.size() && old_entries[i].name < new_entries[j].name)) {
+                changes.push_back({ChangeKind::Removed, join_relative(old_it->first, old_entries[i].name), old_entries[i].type});
+                ++i;
+            } else if (i == old_entries.size() || new_entries[j].name < old_entries[i].name) {
+                changes.push_back({ChangeKind::Added, join_relative(new_it->first, new_entries[j].name), new_entries[j].type});
+                ++j;
+            } else {
+                const auto& a = old_entries[i];
+                const auto& b = new_entries[j];
+                if (a.type != b.type || (b.type == EntryType::File && (a.size != b.size || a.mtime_ns != b.mtime_ns))) {
+                    changes.push_back({ChangeKind::Modified, join_relative(new_it->first, b.name), b.type});
+                }
+                ++i;
+                ++j;
+            }
+        }
+        ++old_it;
+        ++new_it;
+    }
+    return changes;
+}
+
+// Поиск давно не использовавшихся файлов одной папки снимка
+void find_unused_files_in_directory(ScanSnapshot& snapshot, const std::string& rel_path, int days_threshold,
+                                    const ScanMatcher& matcher, std::vector<FileInfo>& unused_files,
+                                    std::time_t* next_change) {
+    auto it = snapshot.directories.find(rel_path);
+    if (it == snapshot.directories.end()) {
+        return;
+    }
+    std::time_t now = std::time(nullptr);
+    const fs::path root = snapshot.root;
+    for (auto& entry : it->second.entries) {
+        if (entry.type != EntryType::File) {
+            continue;
+        }
+        std::time_t mtime = static_cast<std::time_t>(entry.mtime_ns / 1000000000LL);
+        if ((now - mtime) / (24 * 60 * 60) <= days_threshold) {
+            // Файл станет неиспользуемым, когда пройдёт ещё один полный день сверх порога
+            std::time_t becomes_unused = mtime + static_cast<std::time_t>(days_threshold + 1) * 24 * 60 * 60;
+            if (next_change && (*next_change == 0 || becomes_unused < *next_change)) {
+                *next_change = becomes_unused;
+            }
+            continue;
+        }
+        fs::path path = root / join_relative(rel_path, entry.name);
+        if (!matcher.accept_file(path, entry.size, mtime)) {
+            continue;
+        }
+        // Тип, ещё не определённый для файла, читается с диска и сохраняется в снимке
+        if (matcher.filters_types()) {
+            if (!entry.has_type) {
+                entry.file_type = classify_file(path);
+                entry.has_type = true;
+            }
+            if (!matcher.accept_type(entry.file_type)) {
+                continue;
+            }
+        }
+        unused_files.push_back({entry.name, path.string(), static_cast<std::size_t>(entry.size), mtime});
+    }
+}
+
+// Поиск давно не использовавшихся файлов по снимку
+std::vector<FileInfo> find_unused_files_in_snapshot(ScanSnapshot& snapshot, int days_threshold,
+                                                    const ScanMatcher& matcher) {
+    std::vector<FileInfo> unused_files;
+    for (const auto& [rel_path, dir] : snapshot.directories) {
+        find_unused_files_in_directory(snapshot, rel_path, days_threshold, matcher, unused_files);
+    }
+    return unused_files;
+}
+
+std::vector<fs::path> find_empty_directories_in_snapshot(const ScanSnapshot& snapshot) {
+    std::vector<fs::path> empty_dirs;
+    const fs::path root = snapshot.root;
+    for (const auto& [rel_path, dir] : snapshot.directories) {
+        if (!rel_path.empty() && dir.entries.empty()) {
+            empty_dirs.push_back(root / rel_path);
+        }
+    }
+    return empty_dirs;
+}
+
+// Файлы снимка, сгруппированные по размеру
+using SizeBuckets = std::unordered_map<std::uint64_t, std::vector<std::pair<fs::path, SnapshotEntry*>>>;
+
+// Добавление файла в группу его размера, если он проходит правила отбора
+static void add_size_candidate(SizeBuckets& by_size, const fs::path& root, const std::string& rel_path,
+                               SnapshotEntry& entry, const ScanMatcher& matcher) {
+    if (entry.type != EntryType::File) {
+        return;
+    }
+    fs::path path = root / join_relative(rel_path, entry.name);
+    if (matcher.accept_file(path, entry.size, static_cast<std::time_t>(entry.mtime_ns / 1000000000LL))) {
+        by_size[entry.size].emplace_back(std::move(path), &entry);
+    }
+}
+
+// Поиск дубликатов среди файлов, уже разложенных по размерам
+static std::vector<std::vector<fs::path>> find_duplicates_by_size(ScanSnapshot& snapshot, SizeBuckets& by_size,
+                                                                  const ScanMatcher& matcher,
+                                                                  std::vector<FileType>* group_types,
+                                                                  const fs::path& checkpoint_path,
+                                                                  std::vector<DuplicateGroupInfo>* group_info) {
+    // Снимок мог устареть: файл, изменённый на месте, не меняет время папки. Перед тем как
+    // доверять размеру и хэшу из снимка, для каждого кандидата заново вызывается stat.
+    // Файл, размер которого изменился, переходит в группу нового размера; если она стала
+    // больше одного файла, проверяются и её файлы.
+    std::unordered_map<SnapshotEntry*, HashJob> checked;
+    std::vector<std::uint64_t> sizes;
+    for (auto& [size, files] : by_size) {
+        if (files.size() > 1) {
+            sizes.push_back(size);
+        }
+    }
+    while (!sizes.empty()) {
+        std::uint64_t size = sizes.back();
+        sizes.pop_back();
+        auto files = by_size[size];
+        for (auto& [path, entry] : files) {
+            if (checked.count(entry)) {
+                continue;
+            }
+            struct stat st;
+            if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+                checked[entry].failed = true; // Файл исчез после сканирования
+                continue;
+            }
+            update_entry(*entry, st);
+            HashJob& job = checked[entry];
+            job.path = path;
+            job.size = entry->size;
+            job.device = static_cast<std::uint64_t>(st.st_dev);
+            job.inode = static_cast<std::uint64_t>(st.st_ino);
+            if (entry->size != size) {
+                auto& old_files = by_size[size];
+                old_files.erase(std::find_if(old_files.begin(), old_files.end(),
+                                             [&](const auto& file) { return file.second == entry; }));
+                auto& new_files = by_size[entry->size];
+                new_files.emplace_back(path, entry);
+                if (new_files.size() == 2) {
+                    sizes.push_back(entry->size);
+                }
+            }
+        }
+    }
+
+    // При отборе по типу тип определяется по началу файла до хэширования и сохраняется
+    // в снимке: файлы других типов не читаются целиком ни сейчас, ни при следующих анализах
+    if (matcher.filters_types()) {
+        for (auto& [size, files] : by_size) {
+            if (files.size() < 2) {
+                continue;
+            }
+            files.erase(std::remove_if(files.begin(), files.end(), [&](const auto& file) {
+                SnapshotEntry* entry = file.second;
+                if (checked[entry].failed) {
+                    return true;
+                }
+                if (!entry->has_type) {
+                    entry->file_type = classify_file(file.first);
+                    entry->has_type = true;
+                }
+                return !matcher.accept_type(entry->file_type);
+            }), files.end());
+        }
+    }
+
+    // Недостающие хэши вычисляются очередями по устройствам в порядке расположения файлов на диске
+    std::vector<HashJob> queue;
+    std::unordered_map<std::string, SnapshotEntry*> pending;
+    for (auto& [size, files] : by_size) {
+        if (files.size() < 2) {
+            continue;
+        }
+        for (auto& [path, entry] : files) {
+            HashJob& job = checked[entry];
+            if (!job.failed && !entry->has_hash) {
+                pending[path.string()] = entry;
+                queue.push_back(std::move(job));
+            }
+        }
+    }
+    // Хэши сразу записываются в снимок, и он периодически сохраняется в контрольную точку:
+    // после сбоя уже вычисленные хэши не придётся считать заново
+    order_by_physical_layout(queue);
+    CheckpointWriter checkpoint(checkpoint_path, matcher.walk_spec());
+    hash_jobs_by_device(queue, calculate_file_hash64, [&](HashJob& job) {
+        if (!job.failed) {
+            SnapshotEntry* entry = pending[job.path.string()];
+            entry->hash = job.hash;
+            entry->has_hash = true;
+            entry->has_type = true;
+            entry->file_type = job.type;
+        }
+        checkpoint.maybe_save(snapshot);
+        return true;
+    });
+
+    std::vector<std::vector<fs::path>> duplicates;
+    for (auto& [size, files] : by_size) {
+        if (files.size() < 2) {
+            continue;
+        }
+        struct Group {
+            FileType type;
+            std::int64_t oldest_ns;
+            std::vector<fs::path> paths;
+        };
+        std::unordered_map<std::uint64_t, Group> by_hash;
+        for (auto& [path, entry] : files) {
+            if (!checked[entry].failed && entry->has_hash && matcher.accept_type(entry->file_type)) {
+                auto [it, created] = by_hash.try_emplace(entry->hash, Group{entry->file_type, entry->mtime_ns, {}});
+                it->second.oldest_ns = std::min(it->second.oldest_ns, entry->mtime_ns);
+                it->second.paths.push_back(path);
+            }
+        }
+        for (auto& [hash, group] : by_hash) {
+            if (group.paths.size() > 1) {
+                duplicates.push_back(std::move(group.paths));
+                if (group_types) {
+                    group_types->push_back(group.type);
+                }
+                if (group_info) {
+                    group_info->push_back({size, static_cast<std::time_t>(group.oldest_ns / 1000000000LL)});
+                }
+            }
+        }
+    }
+    return duplicates;
+}
+
+// Поиск дубликатов по снимку
+std::vector<std::vector<fs::path>> find_duplicate_files_in_snapshot(ScanSnapshot& snapshot, const ScanMatcher& matcher,
+                                                                    std::vector<FileType>* group_types,
+                                                                    const fs::path& checkpoint_path,
+                                                                    std::vector<DuplicateGroupInfo>* group_info) {
+    const fs::path root = snapshot.root;
+
+    // Хэшировать имеет смысл только файлы с совпадающими размерами
+    SizeBuckets by_size;
+    for (auto& [rel_path, dir] : snapshot.directories) {
+        for (auto& entry : dir.entries) {
+            add_size_candidate(by_size, root, rel_path, entry, matcher);
+        }
+    }
+    return find_duplicates_by_size(snapshot, by_size, matcher, group_types, checkpoint_path, group_info);
+}
+
+// Поиск дубликатов среди заданных файлов снимка
+std::vector<std::vector<fs::path>> find_duplicate_files_among(ScanSnapshot& snapshot,
+                                                              const std::vector<std::string>& rel_files,
+                                                              const ScanMatcher& matcher,
+                                                              std::vector<FileType>* group_types,
+                                                              std::vector<DuplicateGroupInfo>* group_info) {
+    const fs::path root = snapshot.root;
+    SizeBuckets by_size;
+    for (const auto& rel_file : rel_files) {
+        std::size_t slash = rel_file.rfind('/');
+        std::string rel_path = slash == std::string::npos ? std::string() : rel_file.substr(0, slash);
+        std::string name = slash == std::string::npos ? rel_file : rel_file.substr(slash + 1);
+        auto it = snapshot.directories.find(rel_path);
+        if (it == snapshot.directories.end()) {
+            continue;
+        }
+        auto& entries = it->second.entries;
+        auto entry = std::lower_bound(entries.begin(), entries.end(), name,
+                                      [](const SnapshotEntry& e, const std::string& n) { return e.name < n; });
+        if (entry != entries.end() && entry->name == name) {
+            add_size_candidate(by_size, root, rel_path, *entry, matcher);
+        }
+    }
+    return find_duplicates_by_size(snapshot, by_size, matcher, group_types, fs::path(), group_info);
+}
@@ -0,0 +1,145 @@
+#ifndef MODULE_SNAPSHOT_H
+#define MODULE_SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <filesystem>
+#include "module_analization.h"
+#include "module_scan_rules.h"
+
+namespace fs = std::filesystem;
+
+// Тип элемента в снимке
+enum class EntryType : std::uint8_t {
+    File,
+    Directory,
+    Other // Символические ссылки, устройства и т.п.
+};
+
+// Информация об элементе папки на момент сканирования
+struct SnapshotEntry {
+    std::string name;
+    EntryType type;
+    std::uint64_t size;
+    std::int64_t mtime_ns;
+    std::uint64_t hash;   // Хэш содержимого, если уже вычислялся
+    bool has_hash;
+    bool has_type;        // Тип определён (вместе с хэшем или отдельно по началу файла)
+    FileType file_type;   // Тип содержимого
+};
+
+// Папка в снимке: время изменения и отсортированный по имени список элементов
+struct SnapshotDirectory {
+    std::int64_t mtime_ns;
+    std::vector<SnapshotEntry> entries;
+};
+
+// Снимок дерева папок (ключ — путь относительно корня, "" для корня)
+struct ScanSnapshot {
+    std::string root;
+    std::int64_t scan_time_ns = 0;
+    std::map<std::string, SnapshotDirectory> directories;
+};
+
+// Что переносится из прошлого снимка для папок, время изменения которых не поменялось
+enum class SnapshotReuse : std::uint8_t {
+    Entries, // Элементы целиком: stat не вызывается, правка файла на месте не обнаруживается
+    Names    // Только список имён: размер и время каждого элемента читаются заново через stat
+};
+
+// Статистика инкрементального сканирования
+struct RescanStats {
+    std::size_t directories_total = 0;
+    std::size_t directories_reread = 0; // Папки, содержимое которых читалось заново
+    std::size_t entries_stated = 0;     // Количество вызовов stat для элементов
+    bool resumed = false;               // Обход продолжен с контрольной точки
+};
+
+// Вид изменения между двумя снимками
+enum class ChangeKind {
+    Added,
+    Removed,
+    Modified
+};
+
+struct SnapshotChange {
+    ChangeKind kind;
+    std::string path; // Относительно корня
+    EntryType type;
+};
+
+// Сохранение снимка в компактном двоичном виде (запись через временный файл)
+bool save_snapshot(const ScanSnapshot& snapshot, const fs::path& file_path);
+
+// Загрузка снимка; false, если файла нет или он повреждён
+bool load_snapshot(const fs::path& file_path, ScanSnapshot& snapshot);
+
+// Путь к снимку для папки в ~/.cache/analizator
+fs::path default_snapshot_path(const fs::path& root);
+
+// Путь к контрольной точке долгого анализа папки (рядом со снимком).
+// Контрольная точка — частичный снимок с уже вычисленными хэшами и очередь
+// необойдённых папок; после успешного анализа её удаляет вызывающий код.
+fs::path default_checkpoint_path(const fs::path& root);
+
+// Сканирование с использованием предыдущего снимка: папки, время изменения которых
+// не поменялось, не перечитываются, их элементы берутся из снимка. В режиме
+// SnapshotReuse::Entries изменение содержимого файла без изменения папки не обнаруживается;
+// в режиме Names для элементов таких папок заново вызывается stat, и хэш переносится
+// только при тех же размере и времени. Символические ссылки не разыменовываются.
+// Недоступные папки пропускаются и попадают в журнал ошибок анализа. Если задан
+// checkpoint_path, обход периодически сохраняет туда контрольную точку. Точка для того
+// же корня и тех же правил обхода, записанная не более суток назад, при следующем
+// запуске используется как самый свежий снимок: прочитанные до прерывания папки
+// проверяются по времени изменения и перечитываются, только если изменились.
+ScanSnapshot scan_incremental(const fs::path& root, const ScanSnapshot* previous,
+                              const ScanMatcher& matcher = ScanMatcher(), RescanStats* stats = nullptr,
+                              const fs::path& checkpoint_path = fs::path(),
+                              SnapshotReuse reuse = SnapshotReuse::Entries);
+
+// Перечитывание отдельных папок снимка (например, по событиям inotify). Хэши переносятся
+// для файлов с теми же размером и временем изменения. Появившиеся вложенные папки
+// читаются целиком, исчезнувшие удаляются из снимка вместе с поддеревом; их пути
+// дописываются в added и removed.
+void refresh_directories(ScanSnapshot& snapshot, const std::vector<std::string>& rel_paths, const ScanMatcher& matcher,
+                         std::vector<std::string>* added = nullptr, std::vector<std::string>* removed = nullptr);
+
+// Изменения между двумя снимками одного корня
+std::vector<SnapshotChange> diff_snapshots(const ScanSnapshot& before, const ScanSnapshot& after);
+
+// Анализ по снимку без повторного обхода диска. Тип файлов, определённый при отборе
+// по типу, сохраняется в снимке и при следующих вызовах с диска не читается.
+std::vector<FileInfo> find_unused_files_in_snapshot(ScanSnapshot& snapshot, int days_threshold = 30,
+                                                    const ScanMatcher& matcher = ScanMatcher());
+
+// То же для одной папки снимка: найденные файлы дописываются в unused_files. Если передан
+// next_change, в нём запоминается ближайший момент, когда один из более новых файлов
+// папки перейдёт порог (0 — таких файлов нет; меньшее из значений сохраняется).
+void find_unused_files_in_directory(ScanSnapshot& snapshot, const std::string& rel_path, int days_threshold,
+                                    const ScanMatcher& matcher, std::vector<FileInfo>& unused_files,
+                                    std::time_t* next_change = nullptr);
+std::vector<fs::path> find_empty_directories_in_snapshot(const ScanSnapshot& snapshot);
+
+// Поиск дубликатов по снимку: хэши и типы из снимка переиспользуются, новые сохраняются в нём.
+// Перед этим для всех файлов с совпадающими размерами заново вызывается stat: файл,
+// изменённый на месте, получает в снимке новые размер и время и хэшируется заново.
+// Если передан group_types, в него записывается тип каждой найденной группы.
+// Если задан checkpoint_path, снимок с вычисленными хэшами периодически сохраняется туда.
+// Если передан group_info, в него записываются размер и возраст каждой группы.
+std::vector<std::vector<fs::path>> find_duplicate_files_in_snapshot(ScanSnapshot& snapshot,
+                                                                    const ScanMatcher& matcher = ScanMatcher(),
+                                                                    std::vector<FileType>* group_types = nullptr,
+                                                                    const fs::path& checkpoint_path = fs::path(),
+                                                                    std::vector<DuplicateGroupInfo>* group_info = nullptr);
+
+// Поиск дубликатов только среди заданных файлов снимка (пути относительно корня) —
+// для точечного обновления, когда изменились лишь некоторые группы размеров
+std::vector<std::vector<fs::path>> find_duplicate_files_among(ScanSnapshot& snapshot,
+                                                              const std::vector<std::string>& rel_files,
+                                                              const ScanMatcher& matcher = ScanMatcher(),
+                                                              std::vector<FileType>* group_types = nullptr,
+                                                              std::vector<DuplicateGroupInfo>* group_info = nullptr);
+
+#endif // MODULE_SNAPSHOT_H
@@ -0,0 +1,143 @@
+#include "module_ui_latency.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <time.h>
+
+namespace fs = std::filesystem;
+
+// Гистограмма задержек в микросекундах: четыре интервала на каждую степень двойки,
+// так что относительная погрешность перцентилей не превышает 25%, а запись — это
+// одно приращение счётчика
+class LatencyHistogram {
+public:
+    void record(std::uint64_t us) {
+        counts_[bucket_of(us)]++;
+        total_++;
+        max_ = std::max(max_, us);
+    }
+
+    std::uint64_t count() const { return total_; }
+    std::uint64_t max() const { return max_; }
+
+    // Верхняя граница интервала, в который попадает перцентиль
+    std::uint64_t percentile(double fraction) const {
+        std::uint64_t rank = static_cast<std::uint64_t>(fraction * total_);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            seen += counts_[i];
+            if (seen > rank) {
+                return std::min(lower_bound(i + 1) - 1, max_);
+            }
+        }
+        return max_;
+    }
+
+private:
+    static const std::size_t kBuckets = 160;
+
+    static std::size_t bucket_of(std::uint64_t us) {
+        if (us < 4) {
+            return static_cast<std::size_t>(us);
+        }
+        int msb = 63 - __builtin_clzll(us);
+        std::size_t index = 4 * static_cast<std::size_t>(msb - 1) + ((us >> (msb - 2)) & 3);
+        return std::min(index, kBuckets - 1);
+    }
+
+    static std::uint64_t lower_bound(std::size_t index) {
+        if (index < 4) {
+            return index;
+        }
+        std::size_t msb = index / 4 + 1;
+        return (4 + index % 4) << (msb - 2);
+    }
+
+    std::array<std::uint64_t, kBuckets> counts_{};
+    std::uint64_t total_ = 0;
+    std::uint64_t max_ = 0;
+};
+
+static const std::size_t kLoops = 2;
+static const std::size_t kStages = 5;
+static const char* const kLoopNames[kLoops] = {"browser", "editor"};
+static const char* const kStageNames[kStages] = {"update", "listing", "render", "refresh", "total"};
+
+// Состояние трассировки (интерфейс однопоточный)
+static LatencyHistogram histograms[kLoops][kStages];
+static UiLoop current_loop = UiLoop::Browser;
+static std::int64_t key_time_ns = 0;
+static bool event_active = false;
+
+static std::int64_t now_ns() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+static void record(UiLoop loop, UiStage stage, std::int64_t elapsed_ns) {
+    histograms[static_cast<std::size_t>(loop)][static_cast<std::size_t>(stage)]
+        .record(static_cast<std::uint64_t>(std::max<std::int64_t>(elapsed_ns, 0) / 1000));
+}
+
+void latency_key_received(UiLoop loop) {
+    current_loop = loop;
+    key_time_ns = now_ns();
+    event_active = true;
+}
+
+void latency_update_done() {
+    if (event_active) {
+        record(current_loop, UiStage::Update, now_ns() - key_time_ns);
+    }
+}
+
+void latency_discard_event() {
+    event_active = false;
+}
+
+void latency_event_done() {
+    if (event_active) {
+        record(current_loop, UiStage::Total, now_ns() - key_time_ns);
+        event_active = false;
+    }
+}
+
+LatencyScope::LatencyScope(UiLoop loop, UiStage stage) : loop_(loop), stage_(stage), start_ns_(now_ns()) {}
+
+LatencyScope::~LatencyScope() {
+    record(loop_, stage_, now_ns() - start_ns_);
+}
+
+// Сводка по гистограммам
+std::vector<std::string> format_latency_report() {
+    std::vector<std::string> lines;
+    char buffer[160];
+    lines.push_back("Задержки интерфейса, мкс (цикл/этап: n p50 p90 p99 max)");
+    for (std::size_t loop = 0; loop < kLoops; ++loop) {
+        for (std::size_t stage = 0; stage < kStages; ++stage) {
+            const LatencyHistogram& h = histograms[loop][stage];
+            if (h.count() == 0) {
+                continue;
+            }
+            std::snprintf(buffer, sizeof(buffer), "  %s/%s: %llu %llu %llu %llu %llu", kLoopNames[loop], kStageNames[stage],
+                          static_cast<unsigned long long>(h.count()),
+                          static_cast<unsigned long long>(h.percentile(0.50)),
+                          static_cast<unsigned long long>(h.percentile(0.90)),
+                          static_cast<unsigned long long>(h.percentile(0.99)),
+                          static_cast<unsigned long long>(h.max()));
+            lines.push_back(buffer);
+        }
+    }
+    return lines;
+}
+
+// Запись сводки в файл
+bool dump_latency_report(const fs::path& file_path) {
+    std::ofstream out(file_path, std::ios::app);
+    for (const auto& line : format_latency_report()) {
+        out << line << "\n";
+    }
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,58 @@
+#ifndef MODULE_UI_LATENCY_H
+#define MODULE_UI_LATENCY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Цикл обработки ввода, к которому относится замер
+enum class UiLoop {
+    Browser, // Главное окно со списком файлов
+    Editor   // Редактор файла
+};
+
+// Этап обработки нажатия
+enum class UiStage {
+    Update,  // От получения клавиши до конца обработки (изменение модели)
+    Listing, // Перечитывание содержимого папки
+    Render,  // Полная перерисовка окна (включает Listing и Refresh, если они в ней были)
+    Refresh, // wrefresh: вывод изменений на терминал
+    Total    // От получения клавиши до конца перерисовки
+};
+
+// Отметка получения клавиши: начало нового события в цикле loop
+void latency_key_received(UiLoop loop);
+
+// Конец обработки клавиши (этап Update)
+void latency_update_done();
+
+// Событие ждало дополнительного ввода (диалог, подтверждение) и не учитывается
+void latency_discard_event();
+
+// Конец перерисовки после события (этап Total)
+void latency_event_done();
+
+// Замер этапа цикла loop на время жизни объекта (для Listing, Render, Refresh)
+class LatencyScope {
+public:
+    LatencyScope(UiLoop loop, UiStage stage);
+    ~LatencyScope();
+    LatencyScope(const LatencyScope&) = delete;
+    LatencyScope& operator=(const LatencyScope&) = delete;
+
+private:
+    UiLoop loop_;
+    UiStage stage_;
+    std::int64_t start_ns_;
+};
+
+// Сводка по гистограммам: количество, p50, p90, p99 и максимум для каждого цикла и этапа
+std::vector<std::string> format_latency_report();
+
+// Запись сводки в файл; false при ошибке
+bool dump_latency_report(const fs::path& file_path);
+
+#endif // MODULE_UI_LATENCY_H
@@ -0,0 +1,307 @@
+#include "module_watch.h"
+#include <set>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+namespace fs = std::filesystem;
+
+// События, после которых папку нужно перечитать. IN_MODIFY не используется: при
+// потоковой записи он приходит на каждый write, а хэшировать недописанный файл
+// бессмысленно — изменение учитывается по IN_CLOSE_WRITE.
+static const std::uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM |
+                                        IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW;
+
+// Пауза, в течение которой события собираются в одно обновление
+static const int kDebounceMs = 100;
+
+// Наибольшая задержка обновления при непрерывном потоке событий
+static const int kMaxBatchMs = 1000;
+
+// Наибольший таймаут ожидания (в секундах), чтобы миллисекунды поместились в int
+static const std::time_t kMaxPollSeconds = 24 * 60 * 60;
+
+DirectoryWatcher::DirectoryWatcher(const fs::path& root, const ScanMatcher& matcher, int days_threshold)
+    : root_(root), matcher_(matcher), days_threshold_(days_threshold) {
+    fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "Не удалось запустить наблюдение за " + root.string());
+    }
+
+    // Первоначальный анализ использует сохранённый снимок, как и обычный Ctrl+A, но размер
+    // и время каждого файла читаются заново: правки на месте не меняют время папки, и
+    // хэши из снимка для таких файлов были бы устаревшими
+    ScanSnapshot previous;
+    bool has_previous = load_snapshot(default_snapshot_path(root_), previous);
+    snapshot_ = scan_incremental(root_, has_previous ? &previous : nullptr, matcher_, nullptr, fs::path(),
+                                 SnapshotReuse::Names);
+    watch_all();
+    // Изменения между сканированием и установкой наблюдения подхватываются повторным
+    // проходом: перечитываются только папки с изменившимся временем
+    snapshot_ = scan_incremental(root_, &snapshot_, matcher_, nullptr, fs::path(), SnapshotReuse::Names);
+    rebuild();
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void DirectoryWatcher::add_watch(const std::string& rel_path) {
+    if (path_wds_.count(rel_path)) {
+        return;
+    }
+    fs::path full_path = rel_path.empty() ? root_ : root_ / rel_path;
+    int wd = ::inotify_add_watch(fd_, full_path.c_str(), kWatchMask);
+    if (wd < 0) {
+        if (errno == ENOSPC && unwatched_++ == 0) {
+            record_scan_error(full_path, "исчерпан лимит fs.inotify.max_user_watches");
+        } else if (errno != ENOENT && errno != ENOSPC) {
+            record_scan_error(full_path, std::strerror(errno));
+        }
+        return;
+    }
+    wd_paths_[wd] = rel_path;
+    path_wds_[rel_path] = wd;
+}
+
+void DirectoryWatcher::remove_watch(const std::string& rel_path) {
+    auto it = path_wds_.find(rel_path);
+    if (it == path_wds_.end()) {
+        return;
+    }
+    ::inotify_rm_watch(fd_, it->second); // Для удалённой папки ядро уже сняло наблюдение
+    wd_paths_.erase(it->second);
+    path_wds_.erase(it);
+}
+
+void DirectoryWatcher::watch_all() {
+    for (const auto& [rel_path, dir] : snapshot_.directories) {
+        add_watch(rel_path);
+    }
+    // Папки, исчезнувшие из снимка, больше не наблюдаются
+    for (auto it = path_wds_.begin(); it != path_wds_.end();) {
+        if (snapshot_.directories.count(it->first)) {
+            ++it;
+            continue;
+        }
+        ::inotify_rm_watch(fd_, it->second);
+        wd_paths_.erase(it->second);
+        it = path_wds_.erase(it);
+    }
+}
+
+// Учёт результатов папки из снимка; размеры её файлов добавляются в sizes
+void DirectoryWatcher::index_directory(const std::string& rel_path, std::set<std::uint64_t>& sizes) {
+    auto it = snapshot_.directories.find(rel_path);
+    if (it == snapshot_.directories.end()) {
+        return; // Папка удалена
+    }
+    DirectoryResults& results = dir_results_[rel_path];
+    find_unused_files_in_directory(snapshot_, rel_path, days_threshold_, matcher_, results.unused_files,
+                                   &unused_changes_at_);
+    for (const auto& entry : it->second.entries) {
+        if (entry.type != EntryType::File) {
+            continue;
+        }
+        std::string file = rel_path.empty() ? entry.name : rel_path + "/" + entry.name;
+        files_by_size_[entry.size].insert(file);
+        sizes.insert(entry.size);
+        results.files.emplace_back(std::move(file), entry.size);
+    }
+    if (!rel_path.empty() && it->second.entries.empty()) {
+        empty_dirs_.insert(rel_path);
+    }
+}
+
+// Удаление прежних результатов папки; размеры её файлов добавляются в sizes
+void DirectoryWatcher::unindex_directory(const std::string& rel_path, std::set<std::uint64_t>& sizes) {
+    empty_dirs_.erase(rel_path);
+    auto it = dir_results_.find(rel_path);
+    if (it == dir_results_.end()) {
+        return;
+    }
+    for (const auto& [file, size] : it->second.files) {
+        auto bucket = files_by_size_.find(size);
+        bucket->second.erase(file);
+        if (bucket->second.empty()) {
+            files_by_size_.erase(bucket);
+        }
+        sizes.insert(size);
+    }
+    dir_results_.erase(it);
+}
+
+// Полный пересчёт результатов по снимку
+void DirectoryWatcher::rebuild() {
+    dir_results_.clear();
+    files_by_size_.clear();
+    groups_by_size_.clear();
+    empty_dirs_.clear();
+    unused_changes_at_ = 0;
+    std::set<std::string> directories;
+    for (const auto& [rel_path, dir] : snapshot_.directories) {
+        directories.insert(rel_path);
+    }
+    recompute(directories);
+}
+
+// Пересчёт результатов для изменившихся (в том числе появившихся и удалённых) папок
+void DirectoryWatcher::recompute(const std::set<std::string>& directories) {
+    std::set<std::uint64_t> sizes;
+    for (const auto& rel_path : directories) {
+        unindex_directory(rel_path, sizes);
+        index_directory(rel_path, sizes);
+    }
+    refresh_unused();
+
+    // Группы дубликатов пересчитываются только для размеров, набор файлов которых изменился;
+    // хэши неизменившихся файлов берутся из снимка
+    std::vector<std::string> files;
+    for (std::uint64_t size : sizes) {
+        groups_by_size_.erase(size);
+        auto it = files_by_size_.find(size);
+        if (it != files_by_size_.end() && it->second.size() > 1) {
+            files.insert(files.end(), it->second.begin(), it->second.end());
+        }
+    }
+    SizeGroups found;
+    found.groups = find_duplicate_files_among(snapshot_, files, matcher_, &found.types, &found.info);
+    for (std::size_t k = 0; k < found.groups.size(); ++k) {
+        SizeGroups& target = groups_by_size_[found.info[k].file_size];
+        target.groups.push_back(std::move(found.groups[k]));
+        target.types.push_back(found.types[k]);
+        target.info.push_back(found.info[k]);
+    }
+    publish();
+}
+
+// Файлы, перешедшие порог давности без каких-либо событий, добавляются к неиспользуемым.
+// Возвращает true, если пришлось пересчитать.
+bool DirectoryWatcher::refresh_unused() {
+    if (unused_changes_at_ == 0 || std::time(nullptr) < unused_changes_at_) {
+        return false;
+    }
+    unused_changes_at_ = 0;
+    for (auto& [rel_path, results] : dir_results_) {
+        results.unused_files.clear();
+        find_unused_files_in_directory(snapshot_, rel_path, days_threshold_, matcher_, results.unused_files,
+                                       &unused_changes_at_);
+    }
+    return true;
+}
+
+int DirectoryWatcher::poll_timeout_ms() const {
+    if (unused_changes_at_ == 0) {
+        return -1;
+    }
+    std::time_t left = unused_changes_at_ - std::time(nullptr);
+    return left <= 0 ? 0 : static_cast<int>(std::min<std::time_t>(left, kMaxPollSeconds) * 1000);
+}
+
+// Сборка общих результатов из результатов папок и групп размеров
+void DirectoryWatcher::publish() {
+    WatchResults next;
+    for (const auto& [rel_path, results] : dir_results_) {
+        next.unused_files.insert(next.unused_files.end(), results.unused_files.begin(), results.unused_files.end());
+    }
+    for (const auto& [size, found] : groups_by_size_) {
+        next.duplicate_groups.insert(next.duplicate_groups.end(), found.groups.begin(), found.groups.end());
+        next.group_types.insert(next.group_types.end(), found.types.begin(), found.types.end());
+        next.group_info.insert(next.group_info.end(), found.info.begin(), found.info.end());
+    }
+    const fs::path root = snapshot_.root;
+    for (const auto& rel_path : empty_dirs_) {
+        next.empty_dirs.push_back(root / rel_path);
+    }
+    next.generation = results_.generation + (results_.updated_at != 0 ? 1 : 0);
+    next.updated_at = std::time(nullptr);
+    results_ = std::move(next);
+}
+
+bool DirectoryWatcher::update(WatchUpdate* info) {
+    WatchUpdate local;
+    WatchUpdate& stats = info ? *info : local;
+    stats = WatchUpdate();
+
+    std::set<std::string> dirty;
+    bool overflow = false;
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    int waited_ms = 0;
+    while (true) {
+        ssize_t got = ::read(fd_, buffer, sizeof(buffer));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            // Очередь пуста: ждём продолжения пачки событий
+            struct pollfd pfd = {fd_, POLLIN, 0};
+            if (stats.events == 0 || waited_ms >= kMaxBatchMs || ::poll(&pfd, 1, kDebounceMs) <= 0) {
+                break;
+            }
+            waited_ms += kDebounceMs;
+            continue;
+        }
+        for (char* ptr = buffer; ptr < buffer + got;) {
+            auto* event = reinterpret_cast<struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+            stats.events++;
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            auto it = wd_paths_.find(event->wd);
+            if (it == wd_paths_.end()) {
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                // Ядро сняло наблюдение: папка удалена или перемещена за пределы дерева
+                path_wds_.erase(it->second);
+                wd_paths_.erase(it);
+                continue;
+            }
+            dirty.insert(it->second); // Изменилось содержимое папки (или сама папка)
+        }
+    }
+
+    if (overflow) {
+        // События потеряны: состояние восстанавливается инкрементальным пересканированием
+        stats.full_rescan = true;
+        RescanStats rescan;
+        snapshot_ = scan_incremental(root_, &snapshot_, matcher_, &rescan, fs::path(), SnapshotReuse::Names);
+        stats.directories_refreshed = rescan.directories_reread;
+        watch_all();
+        rebuild();
+    } else if (!dirty.empty()) {
+        std::set<std::string> changed = dirty;
+        std::vector<std::string> pending(dirty.begin(), dirty.end());
+        while (!pending.empty()) {
+            std::vector<std::string> added;
+            std::vector<std::string> removed;
+            refresh_directories(snapshot_, pending, matcher_, &added, &removed);
+            stats.directories_refreshed += pending.size();
+            for (const auto& rel_path : removed) {
+                remove_watch(rel_path);
+                changed.insert(rel_path);
+            }
+            for (const auto& rel_path : added) {
+                add_watch(rel_path);
+                changed.insert(rel_path);
+            }
+            // Новые папки перечитываются ещё раз уже под наблюдением: файлы, созданные
+            // в них до установки наблюдения, не должны потеряться
+            pending = std::move(added);
+        }
+        recompute(changed);
+    } else if (refresh_unused()) {
+        publish(); // Событий не было, но файлы перешли порог давности
+    } else {
+        return false;
+    }
+    return true;
+}
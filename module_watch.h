@@ -0,0 +1,107 @@
+#ifndef MODULE_WATCH_H
+#define MODULE_WATCH_H
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <filesystem>
+#include "module_analization.h"
+#include "module_scan_rules.h"
+#include "module_snapshot.h"
+
+namespace fs = std::filesystem;
+
+// Текущие результаты анализа в режиме наблюдения
+struct WatchResults {
+    std::vector<FileInfo> unused_files;
+    std::vector<std::vector<fs::path>> duplicate_groups;
+    std::vector<FileType> group_types;
+    std::vector<DuplicateGroupInfo> group_info;
+    std::vector<fs::path> empty_dirs;
+    std::uint64_t generation = 0; // Номер обновления (0 — первоначальный анализ)
+    std::time_t updated_at = 0;
+};
+
+// Сведения о последнем обновлении
+struct WatchUpdate {
+    std::size_t events = 0;                 // Прочитано событий inotify
+    std::size_t directories_refreshed = 0;  // Папки, содержимое которых читалось заново
+    bool full_rescan = false;               // Очередь событий переполнилась — дерево пересканировано
+};
+
+// Наблюдение за деревом папок через inotify. Анализ выполняется один раз при создании,
+// дальше по событиям перечитываются только изменившиеся папки и хэшируются только
+// изменившиеся файлы. Результаты хранятся по папкам и по размерам файлов: после пачки
+// событий неиспользуемые файлы и пустые папки пересчитываются только для затронутых
+// папок, а дубликаты — только для размеров, файлы которых появились, исчезли или изменились.
+// Ошибки inotify выбрасываются как std::system_error.
+class DirectoryWatcher {
+public:
+    DirectoryWatcher(const fs::path& root, const ScanMatcher& matcher = ScanMatcher(), int days_threshold = 30);
+    ~DirectoryWatcher();
+
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    // Дескриптор inotify для ожидания событий через poll
+    int fd() const { return fd_; }
+
+    // Таймаут poll до момента, когда какой-то файл перейдёт порог давности и update()
+    // нужно вызвать и без событий; -1 — таких файлов нет
+    int poll_timeout_ms() const;
+
+    // Чтение накопившихся событий и обновление результатов. События, пришедшие в течение
+    // короткой паузы после первого, обрабатываются вместе. false, если изменений не было.
+    bool update(WatchUpdate* info = nullptr);
+
+    const WatchResults& results() const { return results_; }
+    const ScanSnapshot& snapshot() const { return snapshot_; }
+    std::size_t watched_directories() const { return wd_paths_.size(); }
+    std::size_t unwatched_directories() const { return unwatched_; } // Не хватило лимита inotify
+
+private:
+    void add_watch(const std::string& rel_path);
+    void remove_watch(const std::string& rel_path);
+    void watch_all();
+
+    // Результаты одной папки
+    struct DirectoryResults {
+        std::vector<FileInfo> unused_files;
+        std::vector<std::pair<std::string, std::uint64_t>> files; // Файлы (путь от корня) и их размеры
+    };
+
+    // Группы дубликатов файлов одного размера
+    struct SizeGroups {
+        std::vector<std::vector<fs::path>> groups;
+        std::vector<FileType> types;
+        std::vector<DuplicateGroupInfo> info;
+    };
+
+    void index_directory(const std::string& rel_path, std::set<std::uint64_t>& sizes);
+    void unindex_directory(const std::string& rel_path, std::set<std::uint64_t>& sizes);
+    void rebuild();
+    void recompute(const std::set<std::string>& directories);
+    bool refresh_unused();
+    void publish();
+
+    fs::path root_;
+    ScanMatcher matcher_;
+    int days_threshold_;
+    int fd_ = -1;
+    ScanSnapshot snapshot_;
+    WatchResults results_;
+    std::map<std::string, DirectoryResults> dir_results_;
+    std::unordered_map<std::uint64_t, std::set<std::string>> files_by_size_;
+    std::map<std::uint64_t, SizeGroups> groups_by_size_;
+    std::set<std::string> empty_dirs_;
+    std::time_t unused_changes_at_ = 0; // Когда какой-то файл перейдёт порог давности (0 — никогда)
+    std::unordered_map<int, std::string> wd_paths_; // Дескриптор наблюдения -> папка
+    std::map<std::string, int> path_wds_;
+    std::size_t unwatched_ = 0;
+};
+
+#endif // MODULE_WATCH_H